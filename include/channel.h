@@ -0,0 +1,425 @@
+#ifndef SERVER_FRAMEWORK_CHANNEL_H
+#define SERVER_FRAMEWORK_CHANNEL_H
+
+#include "fiber_sync.h"
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace zjl
+{
+
+class ChannelSelect;
+
+/**
+ * @brief 通道的公共部分：等待队列与唤醒
+ * 发送方在通道满时、接收方在通道空时登记等待节点并挂起，
+ * 对端操作成功后唤醒一个等待者，被唤醒的一方重新尝试操作
+ * */
+class ChannelBase : public noncopyable
+{
+    friend class ChannelSelect;
+public:
+    // 等待的方向
+    enum Direction
+    {
+        SEND = 0, // 等待通道有空位
+        RECV = 1, // 等待通道有数据
+    };
+
+    // 非阻塞操作的结果
+    enum OpResult
+    {
+        OP_SUCCESS,     // 操作成功
+        OP_WOULD_BLOCK, // 通道满（发送）或空（接收）
+        OP_CLOSED,      // 通道已关闭（接收时表示已关闭并且数据已取完）
+    };
+
+protected:
+    /**
+     * @brief 一次阻塞操作的等待者，select 的所有分支共用一个
+     * 唤醒方先通过 claimed 抢占唤醒权，保证只有一方调用 notify()
+     * */
+    struct Waiter
+    {
+        FiberWaiter waiter;
+        std::atomic_bool claimed{false};
+        // 唤醒它的分支下标，超时为 TIMED_OUT
+        int fired = -1;
+    };
+
+    // 登记在通道上的等待节点，每个 select 分支一个
+    struct WaitNode
+    {
+        Waiter* waiter = nullptr;
+        int index = -1;
+        Direction direction = RECV;
+        WaitNode* prev = nullptr;
+        WaitNode* next = nullptr;
+        bool linked = false;
+    };
+
+    static constexpr int TIMED_OUT = -2;
+
+protected:
+    ~ChannelBase() = default;
+
+    // 操作成功后唤醒一个对端等待者，没有等待者时只有一次原子读
+    void wakeOne(Direction direction)
+    {
+        // 与等待者“先登记、再重试”配对，保证不会错过唤醒
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_wait_lists[direction].size.load(std::memory_order_relaxed) == 0)
+        {
+            return;
+        }
+        wakeOneSlow(direction);
+    }
+
+    // 唤醒所有等待者，用于关闭通道
+    void wakeAll();
+
+private:
+    void wakeOneSlow(Direction direction);
+    void addWaitNode(WaitNode* node);
+    void removeWaitNode(WaitNode* node);
+
+private:
+    struct WaitList
+    {
+        WaitNode* head = nullptr;
+        WaitNode* tail = nullptr;
+        std::atomic_size_t size{0};
+
+        void push(WaitNode* node);
+        void remove(WaitNode* node);
+    };
+
+    // 保护等待队列，只在慢路径上使用
+    Mutex m_mutex;
+    WaitList m_wait_lists[2];
+};
+
+/**
+ * @brief 有界多生产者多消费者通道
+ * 缓冲区是基于序号的无锁环形队列（Vyukov bounded MPMC），send/recv 在通道未满/非空时不加锁；
+ * 满或空时挂起当前协程，不在调度器中时阻塞当前线程。
+ * 关闭后 send 失败，recv 在取完剩余数据后失败。
+ * @param T 元素类型，至少需要可移动构造
+ * */
+template <typename T>
+class Channel : public ChannelBase
+{
+    friend class ChannelSelect;
+public:
+    using ptr = std::shared_ptr<Channel>;
+
+    /**
+     * @brief 构造函数
+     * @param capacity 缓冲区大小，向上取整为 2 的幂
+     * */
+    explicit Channel(size_t capacity)
+    {
+        assert(capacity > 0 && "不支持无缓冲的通道");
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        m_capacity = size;
+        m_mask = size - 1;
+        m_cells = new Cell[size];
+        for (size_t i = 0; i < size; i++)
+        {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~Channel()
+    {
+        // 析构剩余的数据，此时不会再有并发的发送方
+        uint64_t enqueue = m_enqueue_pos.load(std::memory_order_acquire) & ~CLOSED;
+        for (uint64_t pos = m_dequeue_pos.load(std::memory_order_acquire); pos != enqueue; ++pos)
+        {
+            reinterpret_cast<T*>(m_cells[pos & m_mask].storage)->~T();
+        }
+        delete[] m_cells;
+    }
+
+    /**
+     * @brief 发送数据，通道满时挂起
+     * @return 通道已关闭时返回 false
+     * */
+    bool send(const T& value)
+    {
+        T copy(value);
+        return send(std::move(copy));
+    }
+
+    bool send(T&& value);
+
+    // 非阻塞发送，通道满或已关闭时返回 false
+    bool trySend(T value)
+    {
+        return trySendImpl(value) == OP_SUCCESS;
+    }
+
+    /**
+     * @brief 接收数据，通道空时挂起
+     * @param timeout_ms 超时时间，小于 0 表示一直等待。超时依赖 IOManager 的定时器，
+     *                   只能在 IOManager 的线程中使用
+     * @return 超时或通道已关闭并且数据已取完时返回 false
+     * */
+    bool recv(T& value, int64_t timeout_ms = -1);
+
+    // 非阻塞接收，通道空时返回 false
+    bool tryRecv(T& value)
+    {
+        return tryRecvImpl(value) == OP_SUCCESS;
+    }
+
+    // 关闭通道，唤醒所有等待者，重复关闭没有影响
+    void close()
+    {
+        if (m_enqueue_pos.fetch_or(CLOSED, std::memory_order_acq_rel) & CLOSED)
+        {
+            return;
+        }
+        wakeAll();
+    }
+
+    bool isClosed() const
+    {
+        return m_enqueue_pos.load(std::memory_order_acquire) & CLOSED;
+    }
+
+    // 缓冲区中的元素数量，并发修改时只是一个近似值
+    size_t size() const
+    {
+        uint64_t enqueue = m_enqueue_pos.load(std::memory_order_relaxed) & ~CLOSED;
+        uint64_t dequeue = m_dequeue_pos.load(std::memory_order_relaxed);
+        return enqueue > dequeue ? enqueue - dequeue : 0;
+    }
+
+    size_t capacity() const { return m_capacity; }
+
+private:
+    // 成功时从 value 移走数据，否则 value 保持不变
+    OpResult trySendImpl(T& value)
+    {
+        uint64_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true)
+        {
+            if (pos & CLOSED)
+            {
+                return OP_CLOSED;
+            }
+            cell = &m_cells[pos & m_mask];
+            uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+            int64_t diff = static_cast<int64_t>(seq - pos);
+            if (diff == 0)
+            {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            { // 上一轮的数据还没被取走，通道满了
+                return OP_WOULD_BLOCK;
+            }
+            else
+            {
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        new (cell->storage) T(std::move(value));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        wakeOne(RECV);
+        return OP_SUCCESS;
+    }
+
+    OpResult tryRecvImpl(T& value)
+    {
+        uint64_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true)
+        {
+            cell = &m_cells[pos & m_mask];
+            uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+            int64_t diff = static_cast<int64_t>(seq - (pos + 1));
+            if (diff == 0)
+            {
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            { // 通道空了，或者发送方占了位置还没写完，写完后会唤醒接收方
+                uint64_t enqueue = m_enqueue_pos.load(std::memory_order_acquire);
+                if ((enqueue & CLOSED) && (enqueue & ~CLOSED) == pos)
+                {
+                    return OP_CLOSED;
+                }
+                return OP_WOULD_BLOCK;
+            }
+            else
+            {
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        T* item = reinterpret_cast<T*>(cell->storage);
+        value = std::move(*item);
+        item->~T();
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        wakeOne(SEND);
+        return OP_SUCCESS;
+    }
+
+private:
+    // 发送位置的最高位表示通道已关闭，关闭后发送方无法再占用位置
+    static constexpr uint64_t CLOSED = 1ull << 63;
+
+    struct Cell
+    {
+        // 等于位置时可以写入，等于位置 + 1 时可以读取
+        std::atomic_uint64_t sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    Cell* m_cells = nullptr;
+    size_t m_capacity = 0;
+    uint64_t m_mask = 0;
+    alignas(64) std::atomic_uint64_t m_enqueue_pos{0};
+    alignas(64) std::atomic_uint64_t m_dequeue_pos{0};
+};
+
+/**
+ * @brief 在多个通道操作中等待第一个可以完成的操作，类似 Go 的 select
+ * 用法：
+ *     int a; std::string b;
+ *     ChannelSelect select;
+ *     select.recv(ch1, a).recv(ch2, b).send(ch3, 42);
+ *     int index = select.wait(100);
+ * 分支按轮转的顺序尝试，避免总是偏向第一个分支。通道已关闭时对应分支也会完成，此时 ok 为 false
+ * */
+class ChannelSelect : public noncopyable
+{
+public:
+    /**
+     * @brief 添加接收分支
+     * @param value 分支完成时保存接收到的数据
+     * @param ok 可选，分支完成时保存是否真正收到了数据
+     * */
+    template <typename T>
+    ChannelSelect& recv(Channel<T>& channel, T& value, bool* ok = nullptr)
+    {
+        m_cases.push_back({&channel, ChannelBase::RECV, &TryRecv<T>, &value, ItemPtr(nullptr, nullptr), ok});
+        return *this;
+    }
+
+    /**
+     * @brief 添加发送分支，数据先拷贝或移动到分支中，只有分支完成时才会发送
+     * @param ok 可选，分支完成时保存是否真正发送了数据
+     * */
+    template <typename T, typename U>
+    ChannelSelect& send(Channel<T>& channel, U&& value, bool* ok = nullptr)
+    {
+        ItemPtr item(new T(std::forward<U>(value)), &DeleteItem<T>);
+        void* pending = item.get();
+        m_cases.push_back({&channel, ChannelBase::SEND, &TrySend<T>, pending, std::move(item), ok});
+        return *this;
+    }
+
+    // 非阻塞地尝试所有分支，返回完成的分支下标，都无法完成时返回 -1
+    int trySelect();
+
+    /**
+     * @brief 等待直到某个分支完成
+     * @param timeout_ms 超时时间，小于 0 表示一直等待，等于 0 等价于 trySelect()。
+     *                   超时依赖 IOManager 的定时器，只能在 IOManager 的线程中使用
+     * @return 完成的分支下标，超时返回 -1
+     * */
+    int wait(int64_t timeout_ms = -1);
+
+private:
+    // 发送分支待发送的数据，分支完成前由分支持有
+    using ItemPtr = std::unique_ptr<void, void (*)(void*)>;
+    // 对分支的通道做一次非阻塞操作，value 是接收的变量或待发送的数据
+    using AttemptFunc = ChannelBase::OpResult (*)(ChannelBase* channel, void* value);
+
+    struct Case
+    {
+        ChannelBase* channel;
+        ChannelBase::Direction direction;
+        AttemptFunc attempt;
+        void* value;
+        ItemPtr item;
+        bool* ok;
+    };
+
+    template <typename T>
+    static ChannelBase::OpResult TryRecv(ChannelBase* channel, void* value)
+    {
+        return static_cast<Channel<T>*>(channel)->tryRecvImpl(*static_cast<T*>(value));
+    }
+
+    template <typename T>
+    static ChannelBase::OpResult TrySend(ChannelBase* channel, void* value)
+    {
+        return static_cast<Channel<T>*>(channel)->trySendImpl(*static_cast<T*>(value));
+    }
+
+    template <typename T>
+    static void DeleteItem(void* item)
+    {
+        delete static_cast<T*>(item);
+    }
+
+    // 尝试一个分支，完成时返回 true
+    bool attempt(size_t index);
+
+private:
+    std::vector<Case> m_cases;
+    // 下一次从哪个分支开始尝试
+    size_t m_start = 0;
+};
+
+template <typename T>
+bool Channel<T>::send(T&& value)
+{
+    OpResult result = trySendImpl(value);
+    if (result != OP_WOULD_BLOCK)
+    {
+        return result == OP_SUCCESS;
+    }
+    bool ok = false;
+    ChannelSelect select;
+    select.send(*this, std::move(value), &ok);
+    select.wait();
+    return ok;
+}
+
+template <typename T>
+bool Channel<T>::recv(T& value, int64_t timeout_ms)
+{
+    OpResult result = tryRecvImpl(value);
+    if (result != OP_WOULD_BLOCK)
+    {
+        return result == OP_SUCCESS;
+    }
+    bool ok = false;
+    ChannelSelect select;
+    select.recv(*this, value, &ok);
+    return select.wait(timeout_ms) == 0 && ok;
+}
+
+} // namespace zjl
+
+#endif //SERVER_FRAMEWORK_CHANNEL_H
@@ -4,6 +4,7 @@
 // #include "log.h"
 #include "thread.h"
 #include <algorithm>
+#include <atomic>
 #include <boost/lexical_cast.hpp>
 #include <exception>
 #include <functional>
@@ -324,22 +325,23 @@ public:
     // thread-safe 设置配置项的值
     void setValue(const T value)
     {
-        { // 上读锁
-            ReadScopedLock lock(&m_mutex);
+        T old_value;
+        std::map<uint64_t, onChangeCallback> callback_map;
+        { // 上写锁
+            WriteScopedLock lock(&m_mutex);
             if (value == m_value)
             {
                 return;
             }
-            T old_value = m_value;
-            // 值被修改，调用所有的变更事件处理器
-            for (const auto& pair : m_callback_map)
-            {
-                pair.second(old_value, m_value);
-            }
+            old_value = m_value;
+            m_value = value;
+            callback_map = m_callback_map;
+        }
+        // 值被修改，在锁外调用所有的变更事件处理器，处理器中可以读取配置项的值
+        for (const auto& pair : callback_map)
+        {
+            pair.second(old_value, value);
         }
-        // 上写锁
-        WriteScopedLock lock(&m_mutex);
-        m_value = value;
     }
     // 返回配置项的值的字符串
     std::string toString() const override
@@ -390,10 +392,11 @@ public:
     // thread-safe 增加配置项变更事件处理器，返回处理器的唯一编号
     uint64_t addListener(onChangeCallback cb)
     {
-        static uint64_t s_cb_id = 0;
+        static std::atomic_uint64_t s_cb_id{0};
+        uint64_t id = ++s_cb_id;
         WriteScopedLock lock(&m_mutex);
-        m_callback_map[s_cb_id] = cb;
-        return s_cb_id;
+        m_callback_map[id] = cb;
+        return id;
     }
     // thread-safe 删除配置项变更事件处理器
     void delListener(uint64_t key)
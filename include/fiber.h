@@ -2,16 +2,20 @@
 #define SERVER_FRAMEWORK_FIBER_H
 
 #include "config.h"
+#include "fiber_context.h"
 #include "thread.h"
 #include <atomic>
 #include <functional>
 #include <memory>
-#include <ucontext.h>
+#include <vector>
 
 namespace zjl
 {
 
 class Scheduler;
+class CancelToken;
+class StackAllocator;
+class SharedStack;
 
 /**
  * @brief 协程类
@@ -40,8 +44,12 @@ public:
      * @brief 创建新协程
      * @param callback 协程执行函数
      * @param 协程栈大小，如果传 0，使用配置项 "fiber.stack_size" 定义的值
+     * @param shared_stack 是否在共享栈上执行，为 true 时忽略 stack_size。
+     *        共享栈协程挂起时只占用栈上已用部分大小的内存，适合大量空闲的连接处理协程；
+     *        它换出后栈上的对象会被其他协程覆盖，所以不能在栈上的 FiberWaiter 上挂起
+     *        （FiberMutex、FiberCondVar、Future 等），被 hook 的 IO 与 sleep 不受影响
      * */
-    explicit Fiber(FiberFunc callback, size_t stack_size = 0);
+    explicit Fiber(FiberFunc callback, size_t stack_size = 0, bool shared_stack = false);
 //    Fiber(const Fiber& rhs);
     ~Fiber();
 
@@ -78,13 +86,49 @@ public:
     // 获取协程状态
     State getState() const { return m_state; }
 
+    // 获取协程栈大小，master fiber 为 0
+    uint64_t getStackSize() const { return m_stack_size; }
+
+    // 判断地址是否位于协程栈的保护页，只有 mmap 分配的栈有保护页
+    bool inGuardPage(const void* addr) const;
+
+    // 是否在共享栈上执行
+    bool usesSharedStack() const { return m_shared; }
+
+    // 判断地址是否位于协程绑定的共享栈上
+    bool onSharedStack(const void* addr) const;
+
     // 判断协程是否执行结束
     bool finish() const noexcept;
 
+    // 获取协程所属任务组的取消令牌，不属于任何任务组时为 nullptr
+    const std::shared_ptr<CancelToken>& getCancelToken() const { return m_cancel_token; }
+
+    // 设置协程的取消令牌，被 hook 的阻塞调用会在令牌取消时提前返回
+    void setCancelToken(std::shared_ptr<CancelToken> token) { m_cancel_token = std::move(token); }
+
+    // 获取协程的截止时间，毫秒级时间戳，0 表示没有截止时间
+    uint64_t getDeadline() const { return m_deadline_ms; }
+
+    // 设置协程的截止时间，被 hook 的阻塞调用最多等待到截止时间，之后以 ETIMEDOUT 失败
+    void setDeadline(uint64_t deadline_ms) { m_deadline_ms = deadline_ms; }
+
 private:
     // 用于创建 master fiber
     Fiber();
 
+    /**
+     * @brief 换入前独占协程的共享栈，不使用共享栈时直接返回 true
+     * 第一次换入时绑定当前线程的一块共享栈；栈上是其他协程的内容时，先把它拷贝出去，
+     * 再准备初始上下文或者拷回自己的内容
+     * @return 共享栈正被其他协程使用时返回 false
+     * */
+    bool tryAcquireStack();
+    // 换出后释放共享栈
+    void releaseStack();
+    // 把已用的栈内容拷贝到 m_saved_stack
+    void saveStack();
+
 public:
     // 获取当前正在执行的 fiber 的智能指针，如果不存在，则在当前线程上创建 master fiber
     static Fiber::ptr GetThis();
@@ -92,8 +136,17 @@ public:
     static void SetThis(Fiber* fiber);
     // 挂起当前协程，转换为 READY 状态，等待下一次调度
     static void Yield();
-    // 挂起当前协程，转换为 HOLD 状态，等待下一次调度
+    // 挂起当前协程，换出后由调度器转换为 HOLD 状态，等待下一次调度
     static void YieldToHold();
+    // 让出当前任务协程，调度器把它放回任务队列末尾，稍后继续执行
+    static void YieldToReady();
+    /**
+     * @brief 协作式抢占点，CPU 密集的任务在循环中调用
+     * 当前任务本次换入后的执行时间超过配置项 fiber.time_slice_ms 时让出，
+     * 协程放回调度队列末尾，让同一调度线程上的其他任务先执行
+     * @return 是否让出过
+     * */
+    static bool maybeYield();
     // 获取存在的协程数量
     static uint64_t TotalFiber();
     // 获取当前协程 id
@@ -106,14 +159,43 @@ private:
     uint64_t m_id;
     // 协程栈大小
     uint64_t m_stack_size;
-    // 协程状态
-    State m_state;
+    // 协程状态，挂起的协程可能在其他线程上被唤醒，需要原子访问
+    std::atomic<State> m_state;
     // 协程上下文
-    ucontext_t m_ctx;
+    FiberContext m_ctx;
     // 协程栈空间指针
     void* m_stack;
+    // 分配协程栈的分配器
+    StackAllocator* m_allocator = nullptr;
+    // 是否使用共享栈
+    bool m_shared = false;
+    // 绑定的共享栈，第一次换入时绑定
+    std::shared_ptr<SharedStack> m_shared_stack;
+    // 共享栈被其他协程使用时，保存的栈内容及其原来的地址
+    std::vector<char> m_saved_stack;
+    char* m_saved_sp = nullptr;
     // 协程执行函数
     FiberFunc m_callback;
+    // 取消令牌
+    std::shared_ptr<CancelToken> m_cancel_token;
+    // 截止时间
+    uint64_t m_deadline_ms = 0;
+};
+
+/**
+ * @brief 在作用域内给当前协程设置截止时间，离开作用域时恢复
+ * 只会收紧已有的截止时间，不会放宽外层设置的预算
+ * */
+class DeadlineScope : public noncopyable
+{
+public:
+    // timeout_ms 从现在开始计算的超时时间
+    explicit DeadlineScope(uint64_t timeout_ms);
+    ~DeadlineScope();
+
+private:
+    Fiber::ptr m_fiber;
+    uint64_t m_previous;
 };
 
 namespace FiberInfo
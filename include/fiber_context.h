@@ -0,0 +1,76 @@
+#ifndef SERVER_FRAMEWORK_FIBER_CONTEXT_H
+#define SERVER_FRAMEWORK_FIBER_CONTEXT_H
+
+#include <cstddef>
+#include <ucontext.h>
+
+// x86-64 与 aarch64 默认使用汇编实现的上下文切换，编译时定义 ZJL_FIBER_USE_UCONTEXT 可以退回 ucontext
+#if defined(__x86_64__) || defined(__aarch64__)
+#define ZJL_HAS_ASM_CONTEXT 1
+#else
+#define ZJL_HAS_ASM_CONTEXT 0
+#endif
+
+#if ZJL_HAS_ASM_CONTEXT && !defined(ZJL_FIBER_USE_UCONTEXT)
+#define ZJL_FIBER_ASM_CONTEXT 1
+#else
+#define ZJL_FIBER_ASM_CONTEXT 0
+#endif
+
+// 协程入口函数，不能返回
+using ContextEntry = void (*)();
+
+#if ZJL_HAS_ASM_CONTEXT
+/**
+ * @brief 汇编实现的上下文切换
+ * 把被调用者保存的寄存器压入当前栈，栈指针写入 *from_sp，再切换到 to_sp 指向的栈并恢复寄存器。
+ * 调用者保存的寄存器由编译器在调用点处理，不保存信号掩码，切换过程不进入内核
+ * */
+extern "C" void zjl_swap_context(void** from_sp, void* to_sp);
+#endif
+
+namespace zjl
+{
+
+#if ZJL_HAS_ASM_CONTEXT
+/**
+ * @brief 在栈顶构造初始上下文
+ * @return 栈指针，第一次用 zjl_swap_context 切换到它时从 entry 开始执行
+ * */
+void* MakeAsmContext(void* stack, size_t size, ContextEntry entry);
+#endif
+
+/**
+ * @brief 协程上下文
+ * 汇编后端只保存栈指针，ucontext 后端每次切换都要调用 rt_sigprocmask 保存与恢复信号掩码
+ * */
+class FiberContext
+{
+public:
+    // 在 stack 上准备从 entry 开始执行的上下文
+    void make(void* stack, size_t size, ContextEntry entry);
+
+    // 换出时保存的栈指针，低于它的栈空间不再使用；平台不支持时返回 nullptr
+    void* getSP() const;
+
+    // 保存当前上下文到 from，切换到 to
+#if ZJL_FIBER_ASM_CONTEXT
+    static void Swap(FiberContext& from, FiberContext& to) { zjl_swap_context(&from.m_sp, to.m_sp); }
+#else
+    static void Swap(FiberContext& from, FiberContext& to);
+#endif
+
+    // 使用的后端名称
+    static const char* BackendName();
+
+private:
+#if ZJL_FIBER_ASM_CONTEXT
+    void* m_sp = nullptr;
+#else
+    ucontext_t m_ctx{};
+#endif
+};
+
+} // namespace zjl
+
+#endif //SERVER_FRAMEWORK_FIBER_CONTEXT_H
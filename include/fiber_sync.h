@@ -0,0 +1,303 @@
+#ifndef SERVER_FRAMEWORK_FIBER_SYNC_H
+#define SERVER_FRAMEWORK_FIBER_SYNC_H
+
+#include "fiber.h"
+#include "thread.h"
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+
+namespace zjl
+{
+
+class Scheduler;
+
+/**
+ * @brief 等待者
+ * 在调度器的任务协程中等待时，挂起当前协程，被唤醒时通过 Scheduler::schedule() 重新加入调度；
+ * 在普通线程或调度协程中等待时，退化为阻塞线程的信号量。
+ * 对象通常位于等待者自己的栈上，notify() 之后唤醒方不能再访问它
+ * */
+class FiberWaiter : public noncopyable
+{
+public:
+    // 记录当前的协程和调度器
+    FiberWaiter();
+
+    // 挂起当前协程或线程，直到 notify() 被调用
+    void wait();
+
+    // 唤醒等待者 thread-safe
+    void notify();
+
+public:
+    // 等待队列的链表指针
+    FiberWaiter* next = nullptr;
+
+private:
+    Scheduler* m_scheduler = nullptr;
+    Fiber::ptr m_fiber;
+    // 不在任务协程中时使用
+    Semaphore m_semaphore;
+};
+
+/**
+ * @brief 先进先出的等待队列，不是线程安全的，需要由使用者加锁保护
+ * */
+class FiberWaitQueue : public noncopyable
+{
+public:
+    bool empty() const { return m_head == nullptr; }
+
+    void push(FiberWaiter* waiter);
+
+    // 取出队首的等待者，队列为空时返回 nullptr
+    FiberWaiter* pop();
+
+    // 取出所有等待者，返回链表头
+    FiberWaiter* popAll();
+
+private:
+    FiberWaiter* m_head = nullptr;
+    FiberWaiter* m_tail = nullptr;
+};
+
+/**
+ * @brief 协程互斥量
+ * 锁被占用时挂起当前协程而不是阻塞线程，没有竞争时加锁解锁各只有一次原子操作
+ * */
+class FiberMutex : public noncopyable
+{
+public:
+    void lock()
+    {
+        uint32_t expected = UNLOCKED;
+        if (m_state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire))
+        {
+            return;
+        }
+        lockSlow();
+    }
+
+    bool tryLock()
+    {
+        uint32_t expected = UNLOCKED;
+        return m_state.compare_exchange_strong(expected, LOCKED, std::memory_order_acquire);
+    }
+
+    void unlock()
+    {
+        if (m_state.exchange(UNLOCKED, std::memory_order_release) == LOCKED)
+        {
+            return;
+        }
+        unlockSlow();
+    }
+
+private:
+    void lockSlow();
+    void unlockSlow();
+
+private:
+    static constexpr uint32_t UNLOCKED = 0;
+    static constexpr uint32_t LOCKED = 1;
+    // 锁被占用，并且可能有等待者
+    static constexpr uint32_t CONTENDED = 2;
+
+    std::atomic_uint32_t m_state{UNLOCKED};
+    // 保护等待队列
+    Mutex m_mutex;
+    FiberWaitQueue m_waiters;
+};
+
+/**
+ * @brief 协程条件变量，与 FiberMutex 配合使用
+ * 没有等待者时 notify 只有一次原子读
+ * */
+class FiberCondVar : public noncopyable
+{
+public:
+    // 释放 mutex 并挂起，被唤醒后重新获取 mutex，可能被虚假唤醒
+    void wait(FiberMutex& mutex);
+
+    // 等待直到 predicate 返回 true
+    template <typename Predicate>
+    void wait(FiberMutex& mutex, Predicate predicate)
+    {
+        while (!predicate())
+        {
+            wait(mutex);
+        }
+    }
+
+    // 唤醒一个等待者
+    void notifyOne();
+
+    // 唤醒所有等待者
+    void notifyAll();
+
+private:
+    std::atomic_size_t m_waiter_count{0};
+    Mutex m_mutex;
+    FiberWaitQueue m_waiters;
+};
+
+/**
+ * @brief 协程信号量
+ * 计数可以为负数，表示等待者的数量，没有等待者时 wait 与 notify 各只有一次原子操作
+ * */
+class FiberSemaphore : public noncopyable
+{
+public:
+    explicit FiberSemaphore(int64_t count = 0)
+        : m_count(count) {}
+
+    // -1，值小于零时挂起
+    void wait()
+    {
+        if (m_count.fetch_sub(1, std::memory_order_acquire) > 0)
+        {
+            return;
+        }
+        waitSlow();
+    }
+
+    // 值大于零时 -1 并返回 true，否则直接返回 false
+    bool tryWait();
+
+    // +1，有等待者时唤醒一个
+    void notify()
+    {
+        if (m_count.fetch_add(1, std::memory_order_release) >= 0)
+        {
+            return;
+        }
+        notifySlow();
+    }
+
+private:
+    void waitSlow();
+    void notifySlow();
+
+private:
+    std::atomic_int64_t m_count;
+    Mutex m_mutex;
+    FiberWaitQueue m_waiters;
+    // 先于等待者入队到达的唤醒次数
+    uint64_t m_pending_wakeups = 0;
+};
+
+/**
+ * @brief 协程读写锁，写者优先
+ * 没有竞争时加锁解锁各只有一次原子操作，接口与 RWLock 一致
+ * */
+class FiberRWLock : public noncopyable
+{
+public:
+    void readLock()
+    {
+        uint32_t state = m_state.load(std::memory_order_relaxed);
+        if ((state & (WRITER | WAITERS)) == 0 &&
+            m_state.compare_exchange_weak(state, state + 1, std::memory_order_acquire))
+        {
+            return;
+        }
+        readLockSlow();
+    }
+
+    void writeLock()
+    {
+        uint32_t expected = 0;
+        if (m_state.compare_exchange_strong(expected, WRITER, std::memory_order_acquire))
+        {
+            return;
+        }
+        writeLockSlow();
+    }
+
+    // 释放读锁或写锁
+    void unlock();
+
+private:
+    void readLockSlow();
+    void writeLockSlow();
+    // 锁可能已经空闲，唤醒等待者
+    void wakeWaiters();
+
+private:
+    // 写锁被占用
+    static constexpr uint32_t WRITER = 1u << 31;
+    // 可能有等待者
+    static constexpr uint32_t WAITERS = 1u << 30;
+    // 低位是持有读锁的数量
+    static constexpr uint32_t READER_MASK = WAITERS - 1;
+
+    std::atomic_uint32_t m_state{0};
+    Mutex m_mutex;
+    FiberWaitQueue m_readers;
+    FiberWaitQueue m_writers;
+    // 等待写锁的数量，有写者等待时新的读者也要等待
+    size_t m_waiting_writers = 0;
+};
+
+/**
+ * @brief 等待一组任务完成，类似 Go 的 sync.WaitGroup
+ * 启动任务前 add()，任务结束时 done()，wait() 挂起直到计数归零。
+ * 没有等待者时计数归零的一方不会再访问对象，wait() 返回后可以立即销毁
+ * */
+class WaitGroup : public noncopyable
+{
+public:
+    // 计数增加 delta，可以为负数，计数不能小于零
+    void add(int32_t delta = 1)
+    {
+        uint64_t state = m_state.fetch_add(static_cast<uint64_t>(static_cast<int64_t>(delta)) << 32,
+                                           std::memory_order_acq_rel) +
+                         (static_cast<uint64_t>(static_cast<int64_t>(delta)) << 32);
+        assert(static_cast<int32_t>(state >> 32) >= 0 && "WaitGroup 计数小于零");
+        if ((state >> 32) != 0 || static_cast<uint32_t>(state) == 0)
+        {
+            return;
+        }
+        wakeAll();
+    }
+
+    // 计数 -1
+    void done() { add(-1); }
+
+    // 挂起直到计数归零，计数已经为零时直接返回
+    void wait();
+
+    int32_t count() const
+    {
+        return static_cast<int32_t>(m_state.load(std::memory_order_acquire) >> 32);
+    }
+
+private:
+    void wakeAll();
+
+private:
+    // 高 32 位是计数，低 32 位是等待者数量
+    std::atomic_uint64_t m_state{0};
+    Mutex m_mutex;
+    FiberWaitQueue m_waiters;
+};
+
+/**
+ * @brief 协程互斥量的 RAII
+*/
+using FiberScopedLock = ScopedLockImpl<FiberMutex>;
+
+/**
+ * @brief 协程读写锁针对读操作的作用域 RAII 实现
+*/
+using FiberReadScopedLock = ReadScopedLockImpl<FiberRWLock>;
+
+/**
+ * @brief 协程读写锁针对写操作的作用域 RAII 实现
+*/
+using FiberWriteScopedLock = WriteScopedLockImpl<FiberRWLock>;
+
+} // namespace zjl
+
+#endif //SERVER_FRAMEWORK_FIBER_SYNC_H
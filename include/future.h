@@ -0,0 +1,232 @@
+#ifndef SERVER_FRAMEWORK_FUTURE_H
+#define SERVER_FRAMEWORK_FUTURE_H
+
+#include "exception.h"
+#include "fiber_sync.h"
+#include <atomic>
+#include <cassert>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace zjl
+{
+
+/**
+ * @brief Future 与 Promise 共享的状态中与结果类型无关的部分
+ * 等待结果时挂起当前协程，不在调度器中时阻塞当前线程
+ * */
+class FutureStateBase : public noncopyable
+{
+public:
+    bool isReady() const { return m_ready.load(std::memory_order_acquire); }
+
+    // 等待直到结果被设置
+    void wait()
+    {
+        if (isReady())
+        {
+            return;
+        }
+        waitSlow();
+    }
+
+    void setException(std::exception_ptr exception)
+    {
+        ScopedLock lock(&m_mutex);
+        assert(!m_satisfied && "结果只能设置一次");
+        m_exception = std::move(exception);
+        markReady(lock);
+    }
+
+    // 有异常时重新抛出
+    void rethrowIfException() const
+    {
+        if (m_exception)
+        {
+            std::rethrow_exception(m_exception);
+        }
+    }
+
+    // 结果是否已经设置，用于检测 Promise 析构前是否设置过结果
+    bool satisfied()
+    {
+        ScopedLock lock(&m_mutex);
+        return m_satisfied;
+    }
+
+protected:
+    ~FutureStateBase() = default;
+
+    // 标记结果已设置，并唤醒所有等待者，调用前必须持有 m_mutex
+    void markReady(ScopedLock& lock);
+
+private:
+    void waitSlow();
+
+protected:
+    Mutex m_mutex;
+    // 防止重复设置结果
+    bool m_satisfied = false;
+
+private:
+    std::atomic_bool m_ready{false};
+    std::exception_ptr m_exception;
+    FiberWaitQueue m_waiters;
+};
+
+template <typename T>
+class FutureState final : public FutureStateBase
+{
+public:
+    using ptr = std::shared_ptr<FutureState>;
+
+    template <typename U>
+    void setValue(U&& value)
+    {
+        ScopedLock lock(&m_mutex);
+        assert(!m_satisfied && "结果只能设置一次");
+        m_value.emplace(std::forward<U>(value));
+        markReady(lock);
+    }
+
+    T& value() { return *m_value; }
+
+private:
+    std::optional<T> m_value;
+};
+
+template <>
+class FutureState<void> final : public FutureStateBase
+{
+public:
+    using ptr = std::shared_ptr<FutureState>;
+
+    void setValue()
+    {
+        ScopedLock lock(&m_mutex);
+        assert(!m_satisfied && "结果只能设置一次");
+        markReady(lock);
+    }
+};
+
+/**
+ * @brief 异步结果的读取端
+ * 可以拷贝，所有拷贝共享同一个结果，可以被多个协程同时等待
+ * */
+template <typename T>
+class Future
+{
+public:
+    Future() = default;
+
+    explicit Future(typename FutureState<T>::ptr state)
+        : m_state(std::move(state)) {}
+
+    // 是否关联了结果
+    bool valid() const { return m_state != nullptr; }
+
+    // 结果是否已经设置，不会挂起
+    bool isReady() const { return m_state->isReady(); }
+
+    // 等待结果，挂起当前协程
+    void wait() const { m_state->wait(); }
+
+    /**
+     * @brief 等待并获取结果
+     * @exception 任务抛出的异常会在这里重新抛出
+     * */
+    decltype(auto) get() const
+    {
+        m_state->wait();
+        m_state->rethrowIfException();
+        if constexpr (!std::is_void<T>::value)
+        {
+            return m_state->value();
+        }
+    }
+
+private:
+    typename FutureState<T>::ptr m_state;
+};
+
+/**
+ * @brief 异步结果的写入端，只能移动
+ * 析构前没有设置结果时，等待者会收到异常，不会永远挂起
+ * */
+template <typename T>
+class Promise
+{
+public:
+    Promise()
+        : m_state(std::make_shared<FutureState<T>>()) {}
+
+    Promise(Promise&&) noexcept = default;
+    Promise& operator=(Promise&& rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            abandon();
+            m_state = std::move(rhs.m_state);
+        }
+        return *this;
+    }
+
+    Promise(const Promise&) = delete;
+    Promise& operator=(const Promise&) = delete;
+
+    ~Promise() { abandon(); }
+
+    Future<T> getFuture() const { return Future<T>(m_state); }
+
+    template <typename... Args>
+    void setValue(Args&&... args)
+    {
+        m_state->setValue(std::forward<Args>(args)...);
+    }
+
+    void setException(std::exception_ptr exception)
+    {
+        m_state->setException(std::move(exception));
+    }
+
+    // 执行 fn，把返回值或抛出的异常设置为结果
+    template <typename Callable>
+    void setWith(Callable&& fn)
+    {
+        try
+        {
+            if constexpr (std::is_void<T>::value)
+            {
+                fn();
+                setValue();
+            }
+            else
+            {
+                setValue(fn());
+            }
+        }
+        catch (...)
+        {
+            setException(std::current_exception());
+        }
+    }
+
+private:
+    void abandon()
+    {
+        if (m_state && !m_state->satisfied())
+        {
+            m_state->setException(std::make_exception_ptr(Exception("broken promise")));
+        }
+    }
+
+private:
+    typename FutureState<T>::ptr m_state;
+};
+
+} // namespace zjl
+
+#endif //SERVER_FRAMEWORK_FUTURE_H
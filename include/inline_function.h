@@ -0,0 +1,179 @@
+#ifndef SERVER_FRAMEWORK_INLINE_FUNCTION_H
+#define SERVER_FRAMEWORK_INLINE_FUNCTION_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace zjl
+{
+
+/**
+ * @brief 带小对象缓冲区的 void() 可调用对象包装器
+ * 与 std::function 类似，但只支持移动。大小不超过 Capacity 的可调用对象直接存放在内部缓冲区里，
+ * 构造时不需要申请内存；超过时退化为在堆上存放。
+ * @param Capacity 内部缓冲区的字节数
+ * */
+template <size_t Capacity>
+class InlineFunction
+{
+    static_assert(Capacity >= sizeof(void*), "缓冲区至少要能放下一个指针");
+
+private:
+    // 类型擦除后的操作表
+    struct Ops
+    {
+        void (*invoke)(void* storage);
+        // 把 src 中的对象移动到 dst 中，并析构 src 中的对象
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void* storage);
+    };
+
+    template <typename T>
+    static constexpr bool FitsInline =
+        sizeof(T) <= Capacity &&
+        alignof(T) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible<T>::value;
+
+    // 存放在内部缓冲区的对象的操作
+    template <typename T>
+    struct InlineOps
+    {
+        static void invoke(void* storage) { (*static_cast<T*>(storage))(); }
+
+        static void move(void* dst, void* src)
+        {
+            new (dst) T(std::move(*static_cast<T*>(src)));
+            static_cast<T*>(src)->~T();
+        }
+
+        static void destroy(void* storage) { static_cast<T*>(storage)->~T(); }
+
+        static constexpr Ops ops{&invoke, &move, &destroy};
+    };
+
+    // 存放在堆上的对象的操作，内部缓冲区只保存对象指针
+    template <typename T>
+    struct HeapOps
+    {
+        static void invoke(void* storage) { (**static_cast<T**>(storage))(); }
+
+        static void move(void* dst, void* src)
+        {
+            *static_cast<T**>(dst) = *static_cast<T**>(src);
+        }
+
+        static void destroy(void* storage) { delete *static_cast<T**>(storage); }
+
+        static constexpr Ops ops{&invoke, &move, &destroy};
+    };
+
+    template <typename F>
+    using EnableIfCallable = std::enable_if_t<
+        !std::is_same<std::decay_t<F>, InlineFunction>::value &&
+        !std::is_same<std::decay_t<F>, std::nullptr_t>::value>;
+
+public:
+    InlineFunction() noexcept = default;
+
+    InlineFunction(std::nullptr_t) noexcept {}
+
+    template <typename F, typename = EnableIfCallable<F>>
+    InlineFunction(F&& fn)
+    {
+        emplace(std::forward<F>(fn));
+    }
+
+    InlineFunction(InlineFunction&& rhs) noexcept
+    {
+        moveFrom(rhs);
+    }
+
+    InlineFunction(const InlineFunction&) = delete;
+    InlineFunction& operator=(const InlineFunction&) = delete;
+
+    InlineFunction& operator=(InlineFunction&& rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            reset();
+            moveFrom(rhs);
+        }
+        return *this;
+    }
+
+    InlineFunction& operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    template <typename F, typename = EnableIfCallable<F>>
+    InlineFunction& operator=(F&& fn)
+    {
+        reset();
+        emplace(std::forward<F>(fn));
+        return *this;
+    }
+
+    ~InlineFunction() { reset(); }
+
+    explicit operator bool() const noexcept { return m_ops != nullptr; }
+
+    void operator()() { m_ops->invoke(m_storage); }
+
+    // 析构保存的可调用对象
+    void reset() noexcept
+    {
+        if (m_ops)
+        {
+            m_ops->destroy(m_storage);
+            m_ops = nullptr;
+        }
+    }
+
+private:
+    template <typename F>
+    void emplace(F&& fn)
+    {
+        using T = std::decay_t<F>;
+        // 空的 std::function 或函数指针视为空任务，函数引用不可能为空
+        if constexpr (!std::is_function<std::remove_reference_t<F>>::value &&
+                      std::is_constructible<bool, const T&>::value)
+        {
+            if (!static_cast<bool>(fn))
+            {
+                return;
+            }
+        }
+        if constexpr (FitsInline<T>)
+        {
+            new (m_storage) T(std::forward<F>(fn));
+            m_ops = &InlineOps<T>::ops;
+        }
+        else
+        {
+            *reinterpret_cast<T**>(m_storage) = new T(std::forward<F>(fn));
+            m_ops = &HeapOps<T>::ops;
+        }
+    }
+
+    void moveFrom(InlineFunction& rhs) noexcept
+    {
+        if (rhs.m_ops)
+        {
+            rhs.m_ops->move(m_storage, rhs.m_storage);
+            m_ops = rhs.m_ops;
+            rhs.m_ops = nullptr;
+        }
+    }
+
+private:
+    alignas(std::max_align_t) unsigned char m_storage[Capacity];
+    const Ops* m_ops = nullptr;
+};
+
+} // namespace zjl
+
+#endif //SERVER_FRAMEWORK_INLINE_FUNCTION_H
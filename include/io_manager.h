@@ -49,7 +49,8 @@ public: // 内部类型
     using LockType = zjl::RWLock;
 
 public: // 实例方法
-    explicit IOManager(size_t thread_size, bool use_caller = false, std::string name = "");
+    explicit IOManager(size_t thread_size, bool use_caller = false, std::string name = "",
+                       ThreadAffinity affinity = {});
     ~IOManager() override;
 
     // thread-safe 给指定的 fd 增加事件监听，当 callback 是 nullptr 时，将当前上下文转换为协程，并作为事件回调使用
@@ -66,11 +67,19 @@ public: // 类方法
 
 protected:
     void tickle() override;
+    // 用信号打断目标线程的 epoll_pwait
+    void tickleThread(long thread_id) override;
 //    bool onStop() override;
     void onIdle() override;
     bool isStop() override;
     bool isStop(uint64_t& timeout);
     void contextListResize(size_t size);
+    /**
+     * @brief 在进入 epoll_wait 之前自旋等待新任务
+     * 同一时刻只有一条线程自旋，自旋时长根据最近的自旋是否等到任务自动调整
+     * @return 自旋期间是否有新任务到来
+     * */
+    bool spinForTask();
 
     void onTimerInsertedAtFirst() override;
 
@@ -79,6 +88,8 @@ private: // 私有成员
     int m_epoll_fd = 0;                          // epoll 文件标识符
     int m_tickle_fds[2]{0};                      // 主线程给子线程发消息用的管道
     std::atomic_size_t m_pending_event_count{0}; // 等待执行的事件的数量
+    std::atomic_bool m_spinning{false};          // 是否有线程正在自旋等待任务
+    std::atomic_uint64_t m_spin_budget_ns{0};    // 下一次自旋的时长
     std::vector<std::unique_ptr<FDContext>> m_fd_context_list{}; // FDContext 的对象池，下标对应 fd id
 };
 } // namespace zjl
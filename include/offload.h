@@ -0,0 +1,172 @@
+#ifndef SERVER_FRAMEWORK_OFFLOAD_H
+#define SERVER_FRAMEWORK_OFFLOAD_H
+
+#include "fiber_sync.h"
+#include "future.h"
+#include "inline_function.h"
+#include "thread.h"
+#include <atomic>
+#include <deque>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace zjl
+{
+
+/**
+ * @brief 阻塞调用的卸载线程池
+ * 普通文件 IO、getaddrinfo、压缩以及第三方阻塞库不能被 hook 成异步调用，直接在调度线程上执行会阻塞
+ * 该线程上的所有协程。卸载线程池用独立的线程执行这些调用，提交任务的协程挂起等待结果，
+ * 任务完成后重新加入它原来所在的调度器。
+ * 等待队列有容量上限：队列满时 submit() 挂起提交者直到有空位，trySubmit() 直接返回 false
+ * */
+class OffloadPool : public noncopyable
+{
+public:
+    using ptr = std::shared_ptr<OffloadPool>;
+
+    // 卸载线程池的统计信息
+    struct Stats
+    {
+        uint64_t queue_depth = 0;     // 等待执行的任务数量
+        uint64_t max_queue_depth = 0; // 等待执行的任务数量的历史最大值
+        uint64_t running = 0;         // 正在执行的任务数量
+        uint64_t submitted = 0;       // 提交的任务数量
+        uint64_t completed = 0;       // 执行结束的任务数量
+        uint64_t blocked = 0;         // 因为队列已满而等待过的提交次数
+        uint64_t rejected = 0;        // 因为队列已满被 trySubmit() 拒绝的次数
+        uint64_t queue_delay_ns = 0;  // 任务排队时间之和
+
+        // 平均排队时间，单位纳秒
+        double meanQueueDelay() const;
+        std::string toString() const;
+    };
+
+    /**
+     * @brief 构造函数，立即启动线程
+     * @param thread_count 执行任务的线程数量
+     * @param queue_capacity 等待队列的容量
+     * @param name 线程池名称，线程名称为 <name>_<序号>
+     * */
+    OffloadPool(size_t thread_count, size_t queue_capacity, const std::string& name = "offload");
+
+    // 执行完队列中剩余的任务后结束线程
+    ~OffloadPool();
+
+    /**
+     * @brief 提交任务 thread-safe
+     * 队列已满时挂起当前协程（不在协程中时阻塞线程），直到有空位
+     * @return 获取任务结果的 Future，在协程中等待时只挂起协程
+     * */
+    template <typename Callable,
+              typename Result = std::invoke_result_t<std::decay_t<Callable>&>>
+    Future<Result> submit(Callable&& fn)
+    {
+        if (!m_slots.tryWait())
+        {
+            ++m_blocked;
+            m_slots.wait();
+        }
+        return push(std::forward<Callable>(fn));
+    }
+
+    /**
+     * @brief 尝试提交任务，队列已满时不等待 thread-safe
+     * @param future 提交成功时保存获取任务结果的 Future
+     * @return 队列已满时返回 false
+     * */
+    template <typename Callable,
+              typename Result = std::invoke_result_t<std::decay_t<Callable>&>>
+    bool trySubmit(Callable&& fn, Future<Result>& future)
+    {
+        if (!m_slots.tryWait())
+        {
+            ++m_rejected;
+            return false;
+        }
+        future = push(std::forward<Callable>(fn));
+        return true;
+    }
+
+    /**
+     * @brief 在线程池中执行 fn，挂起当前协程等待结果
+     * @exception 重新抛出 fn 抛出的异常
+     * */
+    template <typename Callable>
+    decltype(auto) offload(Callable&& fn)
+    {
+        return submit(std::forward<Callable>(fn)).get();
+    }
+
+    Stats getStats() const;
+
+    const std::string& getName() const { return m_name; }
+
+    /**
+     * @brief 默认的卸载线程池
+     * 线程数量与队列容量由配置项 offload.threads 与 offload.queue_capacity 设置，第一次调用时创建
+     * */
+    static OffloadPool* GetDefault();
+
+private:
+    // 任务节点
+    struct Task
+    {
+        InlineFunction<64> callback;
+        uint64_t enqueue_ns = 0;
+    };
+
+    // 已经占用队列空位后，把任务放入队列
+    template <typename Callable,
+              typename Result = std::invoke_result_t<std::decay_t<Callable>&>>
+    Future<Result> push(Callable&& fn)
+    {
+        Promise<Result> promise;
+        Future<Result> future = promise.getFuture();
+        enqueue([promise = std::move(promise), fn = std::forward<Callable>(fn)]() mutable {
+            promise.setWith(fn);
+        });
+        return future;
+    }
+
+    void enqueue(InlineFunction<64> callback);
+
+    // 线程的执行函数
+    void run();
+
+private:
+    const std::string m_name;
+    std::vector<Thread::ptr> m_threads;
+    // 等待队列
+    mutable Mutex m_mutex;
+    std::deque<Task> m_tasks;
+    // 队列空位，提交者在协程中等待时不占用调度线程
+    FiberSemaphore m_slots;
+    // 队列中的任务数量，以及结束线程的通知
+    Semaphore m_items;
+    bool m_stopping = false;
+
+    std::atomic_uint64_t m_max_queue_depth{0};
+    std::atomic_uint64_t m_running{0};
+    std::atomic_uint64_t m_submitted{0};
+    std::atomic_uint64_t m_completed{0};
+    std::atomic_uint64_t m_blocked{0};
+    std::atomic_uint64_t m_rejected{0};
+    std::atomic_uint64_t m_queue_delay_ns{0};
+};
+
+/**
+ * @brief 在默认的卸载线程池中执行阻塞调用，挂起当前协程等待结果
+ * 例如 zjl::offload([&]() { return ::getaddrinfo(host, nullptr, &hints, &result); })
+ * */
+template <typename Callable>
+decltype(auto) offload(Callable&& fn)
+{
+    return OffloadPool::GetDefault()->offload(std::forward<Callable>(fn));
+}
+
+} // namespace zjl
+
+#endif //SERVER_FRAMEWORK_OFFLOAD_H
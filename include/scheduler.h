@@ -2,10 +2,15 @@
 #define SERVER_FRAMEWORK_SCHEDULER_H
 
 #include "fiber.h"
+#include "future.h"
+#include "inline_function.h"
+#include "task_queue.h"
 #include "thread.h"
 #include <atomic>
-#include <list>
 #include <memory>
+#include <random>
+#include <string>
+#include <type_traits>
 #include <unistd.h>
 #include <utility>
 #include <vector>
@@ -18,47 +23,136 @@ namespace zjl
  * */
 class Scheduler : public noncopyable
 {
+public:
+    /**
+     * @brief 任务优先级
+     * 每个优先级有独立的队列，调度线程按权重轮流从各优先级取任务，
+     * 权重由配置项 scheduler.priority_weights 设置，低优先级的任务也一定会被轮到
+     * */
+    enum Priority
+    {
+        PRIORITY_HIGH = 0,   // 对延迟敏感的任务，例如 IO 事件就绪后恢复的协程
+        PRIORITY_NORMAL = 1, // 普通任务
+        PRIORITY_LOW = 2,    // 后台任务
+    };
+    static constexpr size_t PRIORITY_COUNT = 3;
+
+    /**
+     * @brief 耗时直方图
+     * 按 2 的幂划分区间，第 i 个桶统计耗时在 [2^i, 2^(i+1)) 纳秒之间的样本数
+     * */
+    struct LatencyHistogram
+    {
+        static constexpr size_t BUCKET_COUNT = 64;
+
+        uint64_t buckets[BUCKET_COUNT]{};
+        uint64_t count = 0;
+        uint64_t sum_ns = 0;
+
+        // 平均耗时，单位纳秒
+        double mean() const;
+        // 百分位耗时所在桶的上界，单位纳秒，例如 percentile(0.99)
+        uint64_t percentile(double p) const;
+    };
+
+    // 单条调度线程的统计信息
+    struct WorkerStats
+    {
+        long thread_id = -1;
+        uint64_t tasks = 0;   // 执行任务的次数，协程每换入一次算一次
+        uint64_t steals = 0;  // 从其他调度线程窃取任务的次数
+        uint64_t busy_ns = 0; // 执行任务的时间
+        uint64_t idle_ns = 0; // 执行 idle 协程的时间
+        uint64_t overruns = 0; // 看门狗发现任务连续执行超过阈值的次数
+        uint64_t fiber_reuses = 0; // 回调任务复用缓存协程的次数
+
+        // 忙碌时间占比
+        double utilization() const;
+    };
+
+    /**
+     * @brief 调度器的统计信息
+     * 各调度线程只修改自己的计数，读取时再合并，开启统计的开销只有每个任务几次读时钟
+     * */
+    struct Stats
+    {
+        // 等待执行的任务数量
+        uint64_t queue_length = 0;
+        // 各优先级等待执行的任务数量
+        size_t queue_depth[PRIORITY_COUNT]{};
+        uint64_t active_threads = 0;
+        uint64_t idle_threads = 0;
+        // 任务从放入队列到开始执行的等待时间
+        LatencyHistogram queue_delay;
+        // 任务每次换入后执行的时间
+        LatencyHistogram run_time;
+        std::vector<WorkerStats> workers;
+
+        std::string toString() const;
+    };
+
 private: // 内部类
+    // 任务节点对象池，定义在 scheduler.cc 中
+    struct TaskPool;
+
     /**
      * @brief 任务类
-     * 等待分配线程执行的任务，可以是 zjl::Fiber 或 std::function
+     * 等待分配线程执行的任务，可以是 zjl::Fiber 或可调用对象。
+     * 任务节点从 TaskPool 中获取，用完归还，回调函数存放在节点内部的缓冲区中，
+     * 稳定运行时调度任务不需要申请内存
      * */
     struct Task
     {
-        using ptr = std::shared_ptr<Task>;
-        using uptr = std::unique_ptr<Task>;
-        using TaskFunc = std::function<void()>;
+        // 把任务节点归还给对象池
+        struct Deleter
+        {
+            void operator()(Task* task) const;
+        };
+
+        using uptr = std::unique_ptr<Task, Deleter>;
+        // 回调函数，不超过 64 字节的可调用对象不需要额外申请内存
+        using TaskFunc = InlineFunction<64>;
 
         Fiber::ptr fiber;
         TaskFunc callback;
         long thread_id; // 任务要绑定执行线程的 id
+        Priority priority;
+        bool inline_run;                  // 回调保证不会让出，直接在调度协程上执行
+        uint64_t enqueue_ns;              // 放入队列的时间，用于统计排队时间
+        std::atomic<Task*> next{nullptr}; // 侵入式队列 MPSCQueue 的链表指针
 
         Task()
-            : thread_id(-1) {}
-
-        Task(const Task& rhs) = default;
-
-        Task(Fiber::ptr f, long tid)
-            : fiber(std::move(f)), thread_id(tid) {}
+            : thread_id(-1), priority(PRIORITY_NORMAL), inline_run(false), enqueue_ns(0) {}
 
-        Task(const TaskFunc& cb, long tid)
-            : callback(cb), thread_id(tid) {}
+        // 从对象池中获取一个空的任务节点
+        static uptr Create();
 
-        Task(TaskFunc&& cb, long tid)
-            : callback(std::move(cb)), thread_id(tid) {}
-
-        Task& operator=(const Task& rhs) = default;
+        // 设置任务要执行的 zjl::Fiber 或可调用对象
+        template <typename Executable>
+        void assign(Executable&& exec, long tid, Priority prio)
+        {
+            if constexpr (std::is_convertible<Executable, Fiber::ptr>::value)
+                fiber = std::forward<Executable>(exec);
+            else
+                callback = std::forward<Executable>(exec);
+            thread_id = tid;
+            priority = prio;
+        }
 
         void reset()
         {
             fiber = nullptr;
             callback = nullptr;
             thread_id = -1;
+            priority = PRIORITY_NORMAL;
+            inline_run = false;
+            enqueue_ns = 0;
         }
     };
 
 public: // 内部类型、静态方法、友元声明
     friend class Fiber;
+    friend class WatchdogImpl;
     using ptr = std::shared_ptr<Scheduler>;
     using uptr = std::unique_ptr<Scheduler>;
 
@@ -66,15 +160,30 @@ public: // 内部类型、静态方法、友元声明
     static Scheduler* GetThis();
     // 获取调度器的调度工作协程
     static Fiber* GetMainFiber();
+    // 当前任务本次换入后已经执行的时间，单位纳秒，不在执行调度器的任务时返回 0
+    static uint64_t GetTaskRunTime();
+    /**
+     * @brief 把当前协程迁移到另一个调度器上继续执行
+     * 当前协程让出，加入目标调度器的任务队列，返回时已经运行在目标调度器的线程上，
+     * 之后 GetThis()、hook 状态等线程局部状态都属于目标调度器。只能在调度器的任务协程中调用
+     * @param target 目标调度器，已经在目标调度器上（且满足线程要求）时直接返回
+     * @param thread_id 要在目标调度器的哪条线程上执行，-1 表示任意线程
+     * */
+    static void SwitchTo(Scheduler* target, long thread_id = -1);
 
 public: // 实例方法
     /**
      * @brief 构造函数
-     * @param thread_size 线程池线程数量
+     * @param thread_size 调度线程数量，use_caller 为 true 时包括主线程。
+     *        配置项 scheduler.threads.<name> 存在时以配置项为准，配置项修改后线程数量随之调整
      * @param use_caller 是否将 Scheduler 实例化所在的线程作为 master fiber
      * @param name 调度器名称
+     * @param affinity 线程池线程的放置策略，CPU 列表中的 CPU 依次分配给各条线程，每条线程绑定一个；
+     *        CPU 列表为空时读取配置项 scheduler.cpus.<name>，名称在配置项 scheduler.numa_local 中时
+     *        线程只从本地 NUMA 节点分配内存。use_caller 的主线程不受影响
      * */
-    explicit Scheduler(size_t thread_size, bool use_caller = true, std::string name = "");
+    explicit Scheduler(size_t thread_size, bool use_caller = true, std::string name = "",
+                       ThreadAffinity affinity = {});
     virtual ~Scheduler();
 
     void start();
@@ -85,22 +194,38 @@ public: // 实例方法
         return m_idle_thread_count > 0;
     }
 
+    /**
+     * @brief 运行时调整调度线程数量 thread-safe
+     * 增加时立即启动新线程；减少时被移除的线程执行完当前任务后退出，
+     * 本地队列中的任务转交给其他线程，绑定在该线程上的任务改为不绑定线程。
+     * 线程池的线程数量上限由配置项 scheduler.max_threads 在构造时确定
+     * @param thread_count 调度线程数量，use_caller 为 true 时包括主线程
+     * */
+    void setThreadCount(size_t thread_count);
+    // 调度线程数量，use_caller 为 true 时包括主线程
+    size_t getThreadCount() const;
+    // 某个优先级等待执行的任务数量，包括绑定了线程的任务
+    size_t getQueueDepth(Priority priority) const
+    {
+        return m_queue_depth[priority];
+    }
+    // 合并各调度线程的计数，获取统计信息 thread-safe
+    Stats getStats() const;
+    // 把统计信息输出到 system 日志，并返回输出的文本 thread-safe
+    std::string dumpStats() const;
+
     /**
      * @brief 添加任务 thread-safe
      * @param Executable 模板类型必须是 std::unique_ptr<zjl::Fiber> 或者 std::function
      * @param exec Executable 的实例
-     * @param instant 是否优先调度
      * @param thread_id 任务要绑定执行线程的 id
+     * @param priority 任务优先级
      * */
     template <typename Executable>
-    void schedule(Executable&& exec, long thread_id = -1, bool instant = false)
+    void schedule(Executable&& exec, long thread_id = -1, Priority priority = PRIORITY_NORMAL)
     {
-        bool need_tickle = false;
-        {
-            ScopedLock lock(&m_mutex);
-            // std::forward
-            need_tickle = scheduleNonBlock(std::forward<Executable>(exec), thread_id);
-        }
+        // std::forward
+        bool need_tickle = scheduleNonBlock(std::forward<Executable>(exec), thread_id, priority);
         // 该工作了
         if (need_tickle)
             tickle();
@@ -110,18 +235,16 @@ public: // 实例方法
      * @brief 添加多个任务 thread-safe
      * @param begin 单向迭代器
      * @param end 单向迭代器
+     * @param priority 任务优先级
     */
     template <typename InputIterator>
-    void schedule(InputIterator begin, InputIterator end)
+    void schedule(InputIterator begin, InputIterator end, Priority priority = PRIORITY_NORMAL)
     {
         bool need_tickle = false;
+        while (begin != end)
         {
-            ScopedLock lock(&m_mutex);
-            while (begin != end)
-            {
-                need_tickle = scheduleNonBlock(*begin) || need_tickle;
-                ++begin;
-            }
+            need_tickle = scheduleNonBlock(*begin, -1, priority) || need_tickle;
+            ++begin;
         }
         if (need_tickle)
         {
@@ -129,15 +252,81 @@ public: // 实例方法
         }
     }
 
+    /**
+     * @brief 添加保证不会让出的回调任务 thread-safe
+     * 回调直接在调度线程的调度协程上执行，不创建协程，也没有上下文切换，适合定时器回调、
+     * 统计与簿记之类的小任务。回调执行期间关闭 hook，阻塞调用会阻塞整个调度线程；
+     * 在回调中让出当前协程属于程序错误
+     * @param fn 回调函数
+     * @param thread_id 任务要绑定执行线程的 id
+     * @param priority 任务优先级
+     * */
+    template <typename Callable>
+    void scheduleInline(Callable&& fn, long thread_id = -1, Priority priority = PRIORITY_NORMAL)
+    {
+        auto task = Task::Create();
+        task->assign(std::forward<Callable>(fn), thread_id, priority);
+        if (!task->callback)
+        {
+            return;
+        }
+        task->inline_run = true;
+        if (enqueue(std::move(task)))
+        {
+            tickle();
+        }
+    }
+
+    /**
+     * @brief 添加任务，并返回获取任务结果的 Future thread-safe
+     * @param fn 任务函数，返回值或抛出的异常保存到 Future 中
+     * @param thread_id 任务要绑定执行线程的 id
+     * @param priority 任务优先级
+     * */
+    template <typename Callable,
+              typename Result = std::invoke_result_t<std::decay_t<Callable>&>>
+    Future<Result> scheduleWithResult(Callable&& fn, long thread_id = -1,
+                                      Priority priority = PRIORITY_NORMAL)
+    {
+        Promise<Result> promise;
+        Future<Result> future = promise.getFuture();
+        schedule([promise = std::move(promise), fn = std::forward<Callable>(fn)]() mutable {
+            promise.setWith(fn);
+        }, thread_id, priority);
+        return future;
+    }
+
 protected:
     void run();
     virtual void tickle();
     // 调度器停止时的回调函数，返回调度器当前是否处于停止工作的状态
     virtual bool onStop() { return isStop(); }
+    // 当前线程是否有可以执行的任务，绑定在其他线程上的任务不算
+    bool hasRunnableTask() const;
+    /**
+     * @brief 唤醒指定的调度线程，投递到信箱的任务只能由目标线程执行，不能交给 tickle() 唤醒任意一条空闲线程
+     * 只有通过 setSleeping(true) 标记为阻塞等待的线程才会被唤醒；默认的 onIdle() 不会阻塞，什么也不用做
+     * @param thread_id 目标调度线程的系统线程 id
+     * */
+    virtual void tickleThread(long /*thread_id*/) {}
+    /**
+     * @brief 标记当前调度线程是否即将阻塞等待新任务
+     * 标记为 true 之后、真正阻塞之前必须再检查一次 hasRunnableTask()，与投递任务时先放入信箱再检查标记对应
+     * */
+    void setSleeping(bool sleeping);
+    // 当前调度线程是否因为线程池缩容正在退出，idle 协程应当尽快返回。
+    // run() 在切换到 EXITING 状态之后才会换入 idle 协程等它结束
+    bool isRetiring() const;
+    /**
+     * @brief 开启确定性模拟模式，只能用于 use_caller 且只有主线程的调度器，在 start() 之前调用
+     * 每次从所有等待执行的任务中用给定种子的随机数选择一个，忽略优先级，
+     * 相同的种子和相同的操作序列得到相同的执行顺序
+     * */
+    void enableSimulation(uint64_t seed);
     // 调度器空闲时的回调函数
     virtual void onIdle()
     {
-        while (!isStop())
+        while (!isStop() && !isRetiring())
         {
             Fiber::YieldToHold();
         }
@@ -146,38 +335,190 @@ protected:
 
 private:
     /**
-     * @brief 添加任务 non-thread-safe
+     * @brief 工作线程
+     * 每条调度线程拥有一个本地任务队列，只有自己往里面放任务，其他线程空闲时可以从中窃取任务；
+     * 以及一个信箱，存放绑定在该线程上的任务，任意线程都可以投递，只有自己可以取出
+     * */
+    struct Worker
+    {
+        using uptr = std::unique_ptr<Worker>;
+
+        enum State
+        {
+            FREE,     // 空闲的位置，没有线程在使用
+            ACTIVE,   // 线程正在工作
+            RETIRING, // 线程池缩容，等待线程退出，可以被扩容撤销
+            EXITING,  // 线程正在转交任务并退出
+        };
+
+        std::atomic<State> state{FREE};
+        // 使用该位置的线程池线程，只在持有 m_mutex 时访问
+        Thread::ptr thread;
+        // 调度线程的系统线程 id，线程未启动时为 -1
+        std::atomic_long thread_id{-1};
+        // 本地任务队列，队列中的任务由队列持有
+        WorkStealingQueue<Task*> queue;
+        // 信箱，存放绑定在该线程上的任务
+        MPSCQueue<Task> mailbox;
+        // 信箱中的任务数量
+        std::atomic_size_t mailbox_size{};
+        // 线程是否阻塞等待新任务，投递到信箱时需要单独唤醒
+        std::atomic_bool sleeping{false};
+        // 已经取过任务的轮数，用于按权重选择优先级，只有所属线程会访问
+        uint64_t rounds = 0;
+
+        // 统计计数，只有所属线程写入，其他线程读取时可能读到稍旧的值
+        std::atomic_uint64_t tasks{};
+        std::atomic_uint64_t steals{};
+        std::atomic_uint64_t busy_ns{};
+        std::atomic_uint64_t idle_ns{};
+        std::atomic_uint64_t queue_delay_sum{};
+        std::atomic_uint64_t run_time_sum{};
+        std::atomic_uint64_t queue_delay[LatencyHistogram::BUCKET_COUNT]{};
+        std::atomic_uint64_t run_time[LatencyHistogram::BUCKET_COUNT]{};
+        std::atomic_uint64_t overruns{};
+        std::atomic_uint64_t fiber_reuses{};
+        // 执行结束的回调任务协程，下一个回调任务 reset() 后直接复用，只有所属线程访问
+        std::vector<Fiber::ptr> fiber_cache;
+
+        // 当前任务换入的时间与协程 id，没有执行任务时为 0，供看门狗采样
+        std::atomic_uint64_t run_start_ns{};
+        std::atomic_uint64_t run_fiber_id{};
+        // 看门狗已经报告过的任务换入时间，只有看门狗线程访问
+        uint64_t reported_start_ns = 0;
+
+        ~Worker()
+        {
+            while (Task* task = queue.pop())
+            {
+                Task::Deleter()(task);
+            }
+            while (Task* task = mailbox.pop())
+            {
+                Task::Deleter()(task);
+            }
+        }
+    };
+
+    /**
+     * @brief 共享任务队列
+     * 生产者无锁，同一时刻只能有一条调度线程取任务
+     * */
+    struct SharedQueue
+    {
+        MPSCQueue<Task> queue;
+        // 消费者锁
+        Mutex mutex;
+        // 队列中的任务数量，用于在不加锁的情况下跳过空队列
+        std::atomic_size_t size{};
+
+        ~SharedQueue()
+        {
+            while (Task* task = queue.pop())
+            {
+                Task::Deleter()(task);
+            }
+        }
+    };
+
+    /**
+     * @brief 添加任务 thread-safe
      * @param Executable 模板类型必须是 std::unique_ptr<zjl::Fiber> 或者 std::function
      * @param exec Executable 的实例
      * @param thread_id 任务要绑定执行线程的 id
-     * @param instant 是否优先调度
-     * @return 是否是空闲状态下的第一个新任务
+     * @param priority 任务优先级
+     * @return 是否需要调用 tickle() 唤醒空闲线程，绑定了线程的任务已经直接唤醒目标线程，返回 false
      * */
     template <typename Executable>
-    bool scheduleNonBlock(Executable&& exec, long thread_id = -1, bool instant = false)
+    bool scheduleNonBlock(Executable&& exec, long thread_id = -1, Priority priority = PRIORITY_NORMAL)
     {
-        bool need_tickle = m_task_list.empty();
+        auto task = Task::Create();
         // std::forward
-        auto task = std::make_unique<Task>(std::forward<Executable>(exec), thread_id);
+        task->assign(std::forward<Executable>(exec), thread_id, priority);
         // 创建的任务实例存在有效的 zjl::Fiber 或 std::function
-        if (task->fiber || task->callback)
+        if (!task->fiber && !task->callback)
         {
-            if (instant)
-                m_task_list.push_front(std::move(task));
-            else
-                m_task_list.push_back(std::move(task));
+            return false;
         }
-        return need_tickle;
+        return enqueue(std::move(task));
     }
 
+    /**
+     * @brief 将任务放入合适的队列 thread-safe
+     * 绑定了线程的任务直接投递到目标线程的信箱；调度线程自己产生的普通优先级任务放入本地队列；
+     * 其余任务按优先级放入对应的共享队列。所有队列的生产者均无需加锁
+     * @return 是否需要调用 tickle() 唤醒空闲线程，绑定了线程的任务已经直接唤醒目标线程，返回 false
+     * */
+    bool enqueue(Task::uptr task);
+
+    // 把任务放入对应优先级的共享队列
+    void pushShared(Task* task);
+
+    /**
+     * @brief 把暂时不能执行的任务放回队列，不改变任务计数
+     * @param worker 当前调度线程
+     * */
+    void requeue(Worker& worker, Task::uptr task);
+
+    /**
+     * @brief 为当前调度线程取出一个任务
+     * 先查找信箱，再按权重轮流选择优先级，选中的优先级没有任务时依次尝试其他优先级
+     * @param index 当前调度线程在 m_workers 中的下标
+     * */
+    Task::uptr takeTask(size_t index);
+
+    /**
+     * @brief 取出指定优先级的任务
+     * 普通优先级依次查找本地队列、共享队列，最后从其他调度线程的本地队列窃取，
+     * 从共享队列取任务时每次加锁成批取出，多出的放入本地队列；其他优先级只查找共享队列
+     * */
+    Task::uptr takeTask(size_t index, Priority priority);
+
+    // 查找系统线程 id 对应的调度线程，不属于本调度器时返回 nullptr
+    Worker* findWorker(long thread_id) const;
+
+    // 模拟模式下，取出所有等待执行的任务，从中随机选择一个
+    Task::uptr takeRandomTask(size_t index);
+
+    // 记录任务开始执行，供 GetTaskRunTime() 与看门狗采样
+    void beginRun(Worker& worker, uint64_t fiber_id, uint64_t start_ns);
+    // 记录任务本次执行结束，更新统计信息
+    void endRun(Worker& worker, uint64_t start_ns);
+    // 在调度协程上直接执行 scheduleInline() 添加的回调
+    void runInline(Task::uptr task);
+
+    // 在 m_workers 的 slot 位置启动一条线程池线程，需要持有 m_mutex
+    void startWorker(size_t slot);
+
+    /**
+     * @brief 调度线程退出前，把本地队列和信箱中的任务转交到共享队列，在退出的线程上调用
+     * */
+    void retireWorker(Worker& worker);
+
+    /**
+     * @brief 检查各调度线程当前任务的执行时间，由看门狗线程调用
+     * 超过阈值且还没有报告过的任务计入统计，并输出调用栈
+     * @return 新发现的超时次数
+     * */
+    size_t checkOverruns(uint64_t now_ns, uint64_t threshold_ns);
+
+    // 线程池线程在 m_workers 中的起始下标，use_caller 为 true 时下标 0 属于主线程
+    size_t poolOffset() const { return m_root_thread_id == -1 ? 0 : 1; }
+
 protected:
     const std::string m_name;
     // 主线程 id，仅在 use_caller 为 true 时会被设置有效线程 id
     long m_root_thread_id = 0;
     // 线程 id 列表
     std::vector<long> m_thread_id_list;
-    // 有效线程数量
+    // 线程池线程数量，不包括主线程
     size_t m_thread_count = 0;
+    // 线程池线程的放置策略
+    ThreadAffinity m_affinity;
+    // 等待执行的任务数量
+    std::atomic_uint64_t m_task_count{};
+    // 等待执行的任务中，绑定了线程的任务数量
+    std::atomic_uint64_t m_pinned_task_count{};
     // 活跃线程数量
     std::atomic_uint64_t m_active_thread_count{};
     // 空闲线程数量
@@ -191,10 +532,28 @@ private:
     mutable Mutex m_mutex;
     // 负责调度的协程，仅在类实例化参数中 use_caller 为 true 时有效
     Fiber::ptr m_root_fiber;
-    // 线程对象列表
-    std::vector<Thread::ptr> m_thread_list;
-    // 任务集合
-    std::list<Task::ptr> m_task_list;
+    // 调度线程的工作队列，use_caller 为 true 时下标 0 属于主线程，之后依次是线程池中的线程。
+    // 构造时按线程数量上限一次性创建，之后不再改变大小，其他线程可以不加锁地访问
+    std::vector<Worker::uptr> m_workers;
+    // m_workers 中使用过的位置数量，查找和窃取任务时只需要遍历这些位置
+    std::atomic_size_t m_worker_limit{};
+    // 配置项 scheduler.threads 变更事件处理器的编号
+    uint64_t m_config_listener_id = 0;
+    // 各优先级的共享队列，存放其他线程提交的任务，以及不进入本地队列的高、低优先级任务
+    SharedQueue m_shared_queues[PRIORITY_COUNT];
+    // 各优先级等待执行的任务数量
+    std::atomic_size_t m_queue_depth[PRIORITY_COUNT]{};
+    // 各优先级的调度权重，以及权重之和
+    uint32_t m_priority_weights[PRIORITY_COUNT];
+    uint32_t m_total_weight = 0;
+    // 每次从普通优先级的共享队列最多取出的任务数量
+    size_t m_batch_size = 1;
+    // 每条调度线程缓存的执行结束的协程数量上限
+    size_t m_fiber_cache_size = 0;
+    // 模拟模式的随机数发生器，为空时不是模拟模式
+    std::unique_ptr<std::mt19937_64> m_sim_rng;
+    // 模拟模式下已经从队列取出、等待被选中的任务
+    std::vector<Task::uptr> m_sim_ready;
 };
 } // namespace zjl
 
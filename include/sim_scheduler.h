@@ -0,0 +1,111 @@
+#ifndef SERVER_FRAMEWORK_SIM_SCHEDULER_H
+#define SERVER_FRAMEWORK_SIM_SCHEDULER_H
+
+#include "fiber_sync.h"
+#include "scheduler.h"
+#include "timer.h"
+#include <deque>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <utility>
+
+namespace zjl
+{
+
+/**
+ * @brief 确定性模拟调度器
+ * 只在创建它的线程上运行，每次从所有等待执行的任务中用给定种子的随机数选择一个，
+ * 定时器使用虚拟时钟：没有任务可以执行时，虚拟时钟直接拨到下一个定时器的执行时间。
+ * 被 hook 的 sleep 系列函数使用虚拟时钟，不会真正等待。
+ * 相同的种子和相同的程序得到相同的执行顺序，用于复现调度顺序相关的竞争，
+ * 以及在没有系统噪声的情况下测量调度本身的开销（getStats()）。
+ * 与 use_caller 的 Scheduler 一样，stop()（或析构）时在当前线程上执行任务，
+ * 直到所有任务结束，或者剩下的协程都在等待永远不会发生的事件
+ * */
+class SimScheduler final : public Scheduler, public TimerManager
+{
+public:
+    using ptr = std::shared_ptr<SimScheduler>;
+
+    /**
+     * @brief 构造函数
+     * @param seed 选择任务的随机数种子
+     * @param name 调度器名称
+     * @param start_ms 虚拟时钟的起始时间
+     * */
+    explicit SimScheduler(uint64_t seed, std::string name = "sim", uint64_t start_ms = 0);
+    ~SimScheduler() override;
+
+    // 虚拟时钟的当前时间
+    uint64_t nowMS() const override { return m_now_ms; }
+
+    uint64_t getSeed() const { return m_seed; }
+
+    static SimScheduler* GetThis();
+
+protected:
+    void tickle() override {}
+    void onIdle() override;
+    bool isStop() override;
+    void onTimerInsertedAtFirst() override {}
+
+private:
+    uint64_t m_seed;
+    // 虚拟时钟，只在调度线程上修改
+    uint64_t m_now_ms;
+};
+
+/**
+ * @brief 内存中的回环 socket
+ * 成对创建，一端写入的数据从另一端读出。读取时没有数据则挂起当前协程，
+ * 不经过内核，配合 SimScheduler 使用时网络交互也是确定性的
+ * */
+class LoopbackSocket : public noncopyable
+{
+public:
+    using ptr = std::shared_ptr<LoopbackSocket>;
+
+    // 创建一对相连的 socket
+    static std::pair<ptr, ptr> CreatePair();
+
+    /**
+     * @brief 读取数据，没有数据时挂起当前协程
+     * @return 读取的字节数，对端已经关闭且数据已经读完时返回 0
+     * */
+    ssize_t read(void* buffer, size_t length);
+
+    /**
+     * @brief 写入数据，不会挂起
+     * @return 写入的字节数，对端已经关闭时返回 -1，errno 为 EPIPE
+     * */
+    ssize_t write(const void* buffer, size_t length);
+
+    // 关闭连接，对端读完剩余数据后读到 EOF
+    void close();
+
+    ~LoopbackSocket();
+
+private:
+    // 单向的数据通道
+    struct Pipe
+    {
+        FiberMutex mutex;
+        FiberCondVar readable;
+        std::deque<char> data;
+        bool writer_closed = false;
+        bool reader_closed = false;
+    };
+
+    LoopbackSocket(std::shared_ptr<Pipe> in, std::shared_ptr<Pipe> out)
+        : m_in(std::move(in)), m_out(std::move(out)) {}
+
+private:
+    std::shared_ptr<Pipe> m_in;
+    std::shared_ptr<Pipe> m_out;
+    bool m_closed = false;
+};
+
+} // namespace zjl
+
+#endif //SERVER_FRAMEWORK_SIM_SCHEDULER_H
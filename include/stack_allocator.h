@@ -0,0 +1,159 @@
+#ifndef SERVER_FRAMEWORK_STACK_ALLOCATOR_H
+#define SERVER_FRAMEWORK_STACK_ALLOCATOR_H
+
+#include "noncopyable.h"
+#include "thread.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace zjl
+{
+
+class Fiber;
+
+/**
+ * @brief 协程栈分配器
+ * 新建的协程使用配置项 fiber.stack_allocator 选择的分配器（malloc 或 mmap），
+ * 协程记住分配自己栈的分配器，运行期间修改配置项只影响之后创建的协程
+ * */
+class StackAllocator : public noncopyable
+{
+public:
+    virtual ~StackAllocator() = default;
+
+    // 分配 size 字节的栈，返回栈空间的最低地址
+    virtual void* alloc(size_t size) = 0;
+
+    // 释放 alloc() 分配的栈，size 与分配时相同
+    virtual void dealloc(void* stack, size_t size) = 0;
+
+    virtual const char* getName() const = 0;
+
+    // 配置项 fiber.stack_allocator 选择的分配器
+    static StackAllocator* GetDefault();
+
+    // 按名称获取分配器，不存在时返回 nullptr
+    static StackAllocator* Get(const std::string& name);
+};
+
+/**
+ * @brief 对 malloc/free 简单封装的分配器
+ * */
+class MallocStackAllocator final : public StackAllocator
+{
+public:
+    void* alloc(size_t size) override;
+    void dealloc(void* stack, size_t size) override;
+    const char* getName() const override { return "malloc"; }
+
+    static MallocStackAllocator* GetInstance();
+};
+
+/**
+ * @brief mmap 分配的栈池
+ * 每个栈的低地址端有一个 PROT_NONE 的保护页，栈溢出时立即触发 SIGSEGV，不会悄悄改写相邻的内存。
+ * 释放的栈按大小放入线程局部的空闲链表，超过 fiber.stack_cache_per_thread 时把一半移到全局空闲链表，
+ * 全局链表超过 fiber.stack_cache_global 时才 munmap。
+ * 线程局部的空闲链表只有一份，只能通过 GetInstance() 使用
+ * */
+class MmapStackAllocator final : public StackAllocator
+{
+public:
+    struct Stats
+    {
+        uint64_t mapped = 0;        // 当前 mmap 的栈数量，包括缓存中的
+        uint64_t local_hits = 0;    // 从线程局部空闲链表分配的次数
+        uint64_t global_hits = 0;   // 从全局空闲链表分配的次数
+        uint64_t global_cached = 0; // 全局空闲链表中的栈数量
+    };
+
+    void* alloc(size_t size) override;
+    void dealloc(void* stack, size_t size) override;
+    const char* getName() const override { return "mmap"; }
+
+    Stats getStats() const;
+
+    // 保护页大小，等于系统页大小
+    static size_t GuardSize();
+
+    static MmapStackAllocator* GetInstance();
+
+private:
+    // 按大小分组的空闲栈
+    using FreeList = std::unordered_map<size_t, std::vector<void*>>;
+    // 线程局部的空闲链表，线程退出时把剩余的栈还给全局空闲链表
+    struct LocalCache
+    {
+        FreeList stacks;
+        size_t count = 0;
+        ~LocalCache();
+    };
+
+    MmapStackAllocator() = default;
+
+    void* map(size_t size);
+    void unmap(void* stack, size_t size);
+    // 把栈放入全局空闲链表，超过上限的部分 munmap
+    void pushGlobal(const std::vector<std::pair<void*, size_t>>& stacks);
+
+    // 当前线程的空闲链表，线程退出过程中已经析构时返回 nullptr
+    static LocalCache* GetLocalCache();
+
+private:
+    mutable Mutex m_mutex;
+    FreeList m_global;
+    size_t m_global_count = 0;
+
+    std::atomic_uint64_t m_mapped{0};
+    std::atomic_uint64_t m_local_hits{0};
+    std::atomic_uint64_t m_global_hits{0};
+};
+
+/**
+ * @brief 共享栈
+ * 多个协程轮流在同一块栈上执行。协程换出后内容仍留在栈上，直到另一个协程要在这块栈上执行时，
+ * 才把它已用的部分拷贝到协程自己的缓冲区中，再次换入时拷贝回原来的地址。
+ * 每条线程有 fiber.shared_stack_count 块共享栈，协程第一次换入时按轮转绑定当前线程的一块，
+ * 之后一直使用这块栈：可以在任意线程上换入，但同一时刻一块栈上只能有一个协程在执行
+ * */
+class SharedStack : public noncopyable
+{
+public:
+    using ptr = std::shared_ptr<SharedStack>;
+
+    // size 栈大小，由 MmapStackAllocator 分配，带保护页
+    explicit SharedStack(size_t size);
+    ~SharedStack();
+
+    char* getBottom() const { return m_bottom; }
+    char* getTop() const { return m_bottom + m_size; }
+    size_t getSize() const { return m_size; }
+
+    // 尝试让协程独占这块栈，已经被该协程独占时也返回 true
+    bool tryLock(const Fiber* fiber);
+    void unlock();
+
+    // 栈上保存着哪个协程的内容，只有独占这块栈时才能访问
+    Fiber* getOccupant() const { return m_occupant; }
+    void setOccupant(Fiber* fiber) { m_occupant = fiber; }
+
+    // 当前线程的下一块共享栈，第一次调用时创建当前线程的共享栈
+    static ptr Next();
+
+private:
+    char* m_bottom;
+    size_t m_size;
+    // 正在这块栈上执行的协程
+    std::atomic<const Fiber*> m_owner{nullptr};
+    Fiber* m_occupant = nullptr;
+};
+
+} // namespace zjl
+
+#endif //SERVER_FRAMEWORK_STACK_ALLOCATOR_H
@@ -0,0 +1,127 @@
+#ifndef SERVER_FRAMEWORK_TASK_GROUP_H
+#define SERVER_FRAMEWORK_TASK_GROUP_H
+
+#include "fiber_sync.h"
+#include "timer.h"
+#include <atomic>
+#include <cerrno>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
+
+namespace zjl
+{
+
+class Scheduler;
+class IOManager;
+
+/**
+ * @brief 取消令牌
+ * 协程通过 Fiber::setCancelToken() 关联令牌，被 hook 的阻塞调用（IO、connect、sleep）在等待前注册取消回调，
+ * 令牌被取消时回调取消对应的事件监听或定时器，阻塞调用立刻返回 -1，errno 为取消原因
+ * */
+class CancelToken : public noncopyable
+{
+public:
+    using ptr = std::shared_ptr<CancelToken>;
+
+    bool isCancelled() const { return m_reason.load(std::memory_order_acquire) != 0; }
+
+    // 取消原因，ECANCELED 或 ETIMEDOUT，没有取消时为 0
+    int reason() const { return m_reason.load(std::memory_order_acquire); }
+
+    /**
+     * @brief 取消令牌，依次执行所有已注册的回调，只有第一次调用生效
+     * @param reason 取消原因，作为被中断的阻塞调用的 errno
+     * */
+    void cancel(int reason = ECANCELED);
+
+    /**
+     * @brief 注册取消回调，令牌已经取消时立刻在当前线程执行
+     * @return 回调 id，用于 removeCallback()，立刻执行时返回 0
+     * */
+    uint64_t addCallback(std::function<void()> callback);
+
+    /**
+     * @brief 注销取消回调，回调正在执行时等待它执行结束，返回后回调不会再被执行
+     * */
+    void removeCallback(uint64_t id);
+
+    // 获取当前协程的取消令牌，没有时返回 nullptr
+    static const ptr& GetThis();
+
+private:
+    std::atomic_int m_reason{0};
+    // 回调在持有锁时执行，removeCallback() 借此等待正在执行的回调
+    Mutex m_mutex;
+    std::map<uint64_t, std::function<void()>> m_callbacks;
+    uint64_t m_next_id = 1;
+};
+
+/**
+ * @brief 结构化并发的任务组
+ * spawn() 在调度器上为每个子任务创建协程，wait() 挂起直到所有子任务结束。
+ * 任一子任务抛出异常、到达截止时间或调用 cancel() 时，取消整个任务组：
+ * 还没开始的子任务不再执行，正在执行的子任务中被 hook 的阻塞调用立刻失败返回。
+ * 在另一个任务组的子任务中创建时，外层任务组取消会连带取消内层任务组。
+ * 子任务协程继承创建任务组的协程的截止时间（Fiber::getDeadline()）。
+ * */
+class TaskGroup : public noncopyable
+{
+public:
+    /**
+     * @brief 构造函数
+     * @param scheduler 子任务运行的调度器，默认为当前线程的调度器
+     * */
+    explicit TaskGroup(Scheduler* scheduler = nullptr);
+
+    /**
+     * @brief 带截止时间的任务组，超时后以 ETIMEDOUT 取消，子任务协程的截止时间同时收紧到该时刻
+     * @param iom 子任务运行的 IOManager，同时提供定时器
+     * @param timeout_ms 从构造开始计算的超时时间
+     * */
+    TaskGroup(IOManager* iom, uint64_t timeout_ms);
+
+    // 等待所有子任务结束，忽略子任务的异常
+    ~TaskGroup();
+
+    // 创建子任务 thread-safe
+    void spawn(std::function<void()> fn);
+
+    /**
+     * @brief 等待所有子任务结束
+     * @exception 重新抛出第一个导致任务组被取消的子任务异常
+     * @return 任务组被取消（超时或 cancel()）时返回 false
+     * */
+    bool wait();
+
+    // 取消任务组
+    void cancel(int reason = ECANCELED) { m_token->cancel(reason); }
+
+    bool isCancelled() const { return m_token->isCancelled(); }
+
+    const CancelToken::ptr& getCancelToken() const { return m_token; }
+
+private:
+    // 记录第一个子任务异常，并取消任务组
+    void fail(std::exception_ptr exception);
+
+private:
+    Scheduler* m_scheduler;
+    CancelToken::ptr m_token;
+    // 子任务协程继承的截止时间，0 表示没有
+    uint64_t m_deadline = 0;
+    // 外层任务组的令牌，以及注册在上面的回调
+    CancelToken::ptr m_parent;
+    uint64_t m_parent_callback = 0;
+    Timer::ptr m_deadline_timer;
+    WaitGroup m_wait_group;
+    Mutex m_mutex;
+    std::exception_ptr m_exception;
+};
+
+} // namespace zjl
+
+#endif //SERVER_FRAMEWORK_TASK_GROUP_H
@@ -0,0 +1,218 @@
+#ifndef SERVER_FRAMEWORK_TASK_QUEUE_H
+#define SERVER_FRAMEWORK_TASK_QUEUE_H
+
+#include "noncopyable.h"
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace zjl
+{
+
+/**
+ * @brief 无锁工作窃取队列（Chase-Lev deque）
+ * 只有队列所属的线程可以调用 push()，任意线程都可以调用 steal()。
+ * 所属线程自己取任务时同样调用 steal()，从队首取出，保证任务按 FIFO 顺序执行，
+ * 避免 LIFO 顺序下反复让出的协程饿死队列里的其他任务。
+ * @param T 必须是指针类型，队列不持有元素的所有权
+ * */
+template <typename T>
+class WorkStealingQueue : public noncopyable
+{
+private:
+    // 环形数组，容量为 2 的幂
+    struct Array
+    {
+        int64_t capacity;
+        int64_t mask;
+        std::atomic<T>* buffer;
+
+        explicit Array(int64_t cap)
+            : capacity(cap), mask(cap - 1), buffer(new std::atomic<T>[cap]) {}
+
+        ~Array() { delete[] buffer; }
+
+        T get(int64_t i) const
+        {
+            return buffer[i & mask].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t i, T item)
+        {
+            buffer[i & mask].store(item, std::memory_order_relaxed);
+        }
+
+        // 扩容一倍，并拷贝 [top, bottom) 区间的元素
+        Array* grow(int64_t bottom, int64_t top) const
+        {
+            auto array = new Array(capacity * 2);
+            for (int64_t i = top; i != bottom; ++i)
+            {
+                array->put(i, get(i));
+            }
+            return array;
+        }
+    };
+
+public:
+    explicit WorkStealingQueue(int64_t capacity = 256)
+        : m_array(new Array(capacity))
+    {
+        // 容量必须是 2 的幂
+        assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+    }
+
+    ~WorkStealingQueue()
+    {
+        for (auto array : m_garbage)
+        {
+            delete array;
+        }
+        delete m_array.load();
+    }
+
+    // 队列中的元素数量，并发修改时只是一个近似值
+    size_t size() const
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_relaxed);
+        return static_cast<size_t>(bottom >= top ? bottom - top : 0);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // 在队尾添加元素，只能由队列所属的线程调用
+    void push(T item)
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_acquire);
+        Array* array = m_array.load(std::memory_order_relaxed);
+        if (bottom - top > array->capacity - 1)
+        { // 队列满了，扩容。旧数组可能还在被其他线程读取，留到析构时再释放
+            Array* new_array = array->grow(bottom, top);
+            m_garbage.push_back(array);
+            array = new_array;
+            m_array.store(array, std::memory_order_release);
+        }
+        array->put(bottom, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+
+    // 从队首取出元素，任意线程可调用，队列为空或竞争失败时返回 nullptr
+    T steal()
+    {
+        int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = m_bottom.load(std::memory_order_acquire);
+        if (top < bottom)
+        {
+            Array* array = m_array.load(std::memory_order_acquire);
+            T item = array->get(top);
+            if (!m_top.compare_exchange_strong(top, top + 1,
+                                               std::memory_order_seq_cst,
+                                               std::memory_order_relaxed))
+            { // 被其他线程抢先取走了
+                return nullptr;
+            }
+            return item;
+        }
+        return nullptr;
+    }
+
+    // 队列所属线程取出队首元素，竞争失败时重试，队列为空时返回 nullptr
+    T pop()
+    {
+        while (!empty())
+        {
+            T item = steal();
+            if (item)
+            {
+                return item;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> m_top{0};
+    alignas(64) std::atomic<int64_t> m_bottom{0};
+    std::atomic<Array*> m_array;
+    // 扩容后被替换下来的数组
+    std::vector<Array*> m_garbage;
+};
+
+/**
+ * @brief 无锁多生产者单消费者侵入式队列（Vyukov MPSC）
+ * 任意线程都可以并发调用 push()，且不会阻塞；同一时刻只能有一个线程调用 pop()，
+ * 多个消费者需要自己加锁互斥。
+ * @param T 节点类型，需要有 std::atomic<T*> next 成员，并且可以默认构造（用作哨兵节点）
+ * */
+template <typename T>
+class MPSCQueue : public noncopyable
+{
+public:
+    MPSCQueue()
+        : m_head(&m_stub), m_tail(&m_stub)
+    {
+        m_stub.next.store(nullptr, std::memory_order_relaxed);
+    }
+
+    // 在队尾添加节点，线程安全，队列不持有节点的所有权
+    void push(T* node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        T* prev = m_head.exchange(node, std::memory_order_acq_rel);
+        // 在这两步之间，消费者看到的队列是断开的，pop() 会暂时返回 nullptr
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // 从队首取出节点，只能由唯一的消费者调用，队列为空时返回 nullptr
+    T* pop()
+    {
+        T* tail = m_tail;
+        T* next = tail->next.load(std::memory_order_acquire);
+        if (tail == &m_stub)
+        { // 跳过哨兵节点
+            if (next == nullptr)
+            {
+                return nullptr;
+            }
+            m_tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next)
+        {
+            m_tail = next;
+            return tail;
+        }
+        T* head = m_head.load(std::memory_order_acquire);
+        if (tail != head)
+        { // 生产者还没有完成链接
+            return nullptr;
+        }
+        // 只剩最后一个节点，重新放入哨兵节点后才能取出
+        push(&m_stub);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next)
+        {
+            m_tail = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+private:
+    // 生产者写入的队尾
+    alignas(64) std::atomic<T*> m_head;
+    // 消费者读取的队首
+    alignas(64) T* m_tail;
+    T m_stub;
+};
+
+} // namespace zjl
+
+#endif //SERVER_FRAMEWORK_TASK_QUEUE_H
@@ -9,6 +9,7 @@
 #include <cstdint>
 #include <sys/types.h>
 #include <unistd.h>
+#include <vector>
 
 namespace zjl
 {
@@ -230,6 +231,18 @@ using ReadScopedLock = ReadScopedLockImpl<RWLock>;
 */
 using WriteScopedLock = WriteScopedLockImpl<RWLock>;
 
+/**
+ * @brief 线程的放置策略
+ * 在线程函数执行之前生效，线程之后申请的内存（例如协程栈）会从它所在的 NUMA 节点分配
+*/
+struct ThreadAffinity
+{
+    // 允许线程运行的 CPU 编号，为空时不限制
+    std::vector<int> cpus;
+    // 是否只从线程当前运行的 NUMA 节点分配内存
+    bool numa_local = false;
+};
+
 /**
  * @brief 线程类
  * 基于 pthread 封装的
@@ -241,7 +254,7 @@ public:
     typedef std::unique_ptr<Thread> uptr;
     typedef std::function<void()> ThreadFunc;
 
-    Thread(ThreadFunc callback, const std::string& name);
+    Thread(ThreadFunc callback, const std::string& name, ThreadAffinity affinity = {});
     ~Thread();
     // 获取线程 id
     pid_t getId() const;
@@ -261,6 +274,8 @@ public:
     static const std::string& GetThisThreadName();
     // 设置当前运行线程的名称
     static void SetThisThreadName(const std::string& name);
+    // 设置当前运行线程的 CPU 亲和性与内存策略，成功返回 true
+    static bool SetThisAffinity(const ThreadAffinity& affinity);
     // 启动线程, 接收 Thread*
     static void* Run(void* arg);
 
@@ -1,6 +1,7 @@
 #ifndef SERVER_FRAMEWORK_TIMER_H
 #define SERVER_FRAMEWORK_TIMER_H
 
+#include <atomic>
 #include <set>
 #include <vector>
 #include <memory>
@@ -58,6 +59,7 @@ private:
     bool m_cyclic = false;  // 是否重复
     uint64_t m_ms = 0;      // 执行周期
     uint64_t m_next = 0;    // 执行的绝对时间戳
+    uint64_t m_seq = 0;     // 创建顺序，执行时间相同的定时器按创建顺序执行
     std::function<void()> m_fn;
     TimerManager* m_manager = nullptr;
 
@@ -114,6 +116,11 @@ public:
     */
     bool hasTimer();
 
+    /**
+     * @brief 定时器使用的当前时间，毫秒级时间戳。默认为系统时间，模拟调度器用虚拟时钟替换
+    */
+    virtual uint64_t nowMS() const;
+
 protected:
     /**
      * @brief 当创建了延迟时间最短的定时任务时，会调用此函数
@@ -135,6 +142,8 @@ private:
     RWLockType m_lock;
     std::set<Timer::ptr, Timer::Comparator> m_timers;
     uint64_t m_previous_time = 0;
+    // 已经创建的定时器数量，用于生成定时器的创建顺序
+    std::atomic_uint64_t m_timer_seq{0};
 };
 
 } // end namespace zjl
@@ -46,5 +46,10 @@ uint64_t GetCurrentMS();
 */
 uint64_t GetCurrentUS();
 
+/**
+ * @brief 获取ns时间，使用单调时钟，只适合用来计算时间间隔
+*/
+uint64_t GetCurrentNS();
+
 } // namespace zjl
 #endif
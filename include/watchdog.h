@@ -0,0 +1,63 @@
+#ifndef SERVER_FRAMEWORK_WATCHDOG_H
+#define SERVER_FRAMEWORK_WATCHDOG_H
+
+#include "noncopyable.h"
+#include "singleton.h"
+#include "thread.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace zjl
+{
+
+class Scheduler;
+
+/**
+ * @brief 长时间运行协程的看门狗
+ * 后台线程按配置项 watchdog.interval_ms 的间隔采样已启动调度器的各调度线程，
+ * 当前任务连续执行超过 watchdog.threshold_ms 时记为一次超时：计入调度线程的统计，
+ * 向该线程发送 SIGURG 获取调用栈，并输出到 system 日志。一次执行只报告一次。
+ * 协程不会被强制换出，CPU 密集的任务需要自己调用 Fiber::maybeYield() 让出
+ * */
+class WatchdogImpl : public noncopyable
+{
+public:
+    WatchdogImpl() = default;
+    ~WatchdogImpl();
+
+    // 开始监视调度器，由 Scheduler::start() 调用 thread-safe
+    void add(Scheduler* scheduler);
+    // 停止监视调度器，返回后不会再访问该调度器，由 Scheduler::~Scheduler() 调用 thread-safe
+    void del(Scheduler* scheduler);
+    // 所有调度器累计的超时次数
+    uint64_t getOverrunCount() const { return m_overruns; }
+
+    /**
+     * @brief 获取另一条线程当前的调用栈
+     * 向线程发送 SIGURG，在信号处理函数中记录调用栈，同一时刻只能有一个请求
+     * @param thread_id 系统线程 id
+     * @param timeout_ms 等待线程响应信号的时间
+     * @return 调用栈字符串，线程没有及时响应时返回空字符串
+     * */
+    std::string captureBacktrace(long thread_id, uint64_t timeout_ms = 100);
+
+private:
+    // 看门狗线程的执行函数
+    void run();
+
+private:
+    Mutex m_mutex;
+    std::vector<Scheduler*> m_schedulers;
+    Thread::ptr m_thread;
+    std::atomic_bool m_stopping{false};
+    std::atomic_uint64_t m_overruns{0};
+    // 串行化 captureBacktrace()
+    Mutex m_trace_mutex;
+};
+
+using Watchdog = Singleton<WatchdogImpl>;
+
+} // namespace zjl
+
+#endif //SERVER_FRAMEWORK_WATCHDOG_H
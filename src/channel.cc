@@ -0,0 +1,257 @@
+#include "channel.h"
+#include "io_manager.h"
+#include "util.h"
+
+namespace zjl
+{
+
+/**
+ * =========================================
+ * ChannelBase 类的实现
+ * =========================================
+*/
+
+void ChannelBase::WaitList::push(WaitNode* node)
+{
+    node->prev = tail;
+    node->next = nullptr;
+    if (tail)
+    {
+        tail->next = node;
+    }
+    else
+    {
+        head = node;
+    }
+    tail = node;
+    node->linked = true;
+    size.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ChannelBase::WaitList::remove(WaitNode* node)
+{
+    if (node->prev)
+    {
+        node->prev->next = node->next;
+    }
+    else
+    {
+        head = node->next;
+    }
+    if (node->next)
+    {
+        node->next->prev = node->prev;
+    }
+    else
+    {
+        tail = node->prev;
+    }
+    node->prev = node->next = nullptr;
+    node->linked = false;
+    size.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void ChannelBase::addWaitNode(WaitNode* node)
+{
+    ScopedLock lock(&m_mutex);
+    m_wait_lists[node->direction].push(node);
+}
+
+void ChannelBase::removeWaitNode(WaitNode* node)
+{
+    ScopedLock lock(&m_mutex);
+    // 可能已经被唤醒方摘掉了
+    if (node->linked)
+    {
+        m_wait_lists[node->direction].remove(node);
+    }
+}
+
+void ChannelBase::wakeOneSlow(Direction direction)
+{
+    Waiter* target = nullptr;
+    {
+        ScopedLock lock(&m_mutex);
+        WaitList& list = m_wait_lists[direction];
+        while (list.head)
+        {
+            WaitNode* node = list.head;
+            list.remove(node);
+            // 等待者可能已经被其他通道或者超时唤醒了，跳过它
+            if (!node->waiter->claimed.exchange(true, std::memory_order_acq_rel))
+            {
+                node->waiter->fired = node->index;
+                target = node->waiter;
+                break;
+            }
+        }
+    }
+    // 在被 notify 之前等待者不会返回，这里访问 target 是安全的
+    if (target)
+    {
+        target->waiter.notify();
+    }
+}
+
+void ChannelBase::wakeAll()
+{
+    std::vector<Waiter*> targets;
+    {
+        ScopedLock lock(&m_mutex);
+        for (auto& list : m_wait_lists)
+        {
+            while (list.head)
+            {
+                WaitNode* node = list.head;
+                list.remove(node);
+                if (!node->waiter->claimed.exchange(true, std::memory_order_acq_rel))
+                {
+                    node->waiter->fired = node->index;
+                    targets.push_back(node->waiter);
+                }
+            }
+        }
+    }
+    for (auto target : targets)
+    {
+        target->waiter.notify();
+    }
+}
+
+/**
+ * =========================================
+ * ChannelSelect 类的实现
+ * =========================================
+*/
+
+bool ChannelSelect::attempt(size_t index)
+{
+    Case& c = m_cases[index];
+    ChannelBase::OpResult result = c.attempt(c.channel, c.value);
+    if (result == ChannelBase::OP_WOULD_BLOCK)
+    {
+        return false;
+    }
+    if (c.ok)
+    {
+        *c.ok = result == ChannelBase::OP_SUCCESS;
+    }
+    return true;
+}
+
+int ChannelSelect::trySelect()
+{
+    size_t count = m_cases.size();
+    size_t start = m_start++;
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t index = (start + i) % count;
+        if (attempt(index))
+        {
+            return static_cast<int>(index);
+        }
+    }
+    return -1;
+}
+
+int ChannelSelect::wait(int64_t timeout_ms)
+{
+    assert(!m_cases.empty());
+    int index = trySelect();
+    if (index >= 0 || timeout_ms == 0)
+    {
+        return index;
+    }
+    IOManager* iom = nullptr;
+    uint64_t deadline = 0;
+    if (timeout_ms > 0)
+    {
+        iom = IOManager::GetThis();
+        assert(iom && "带超时的等待只能在 IOManager 中使用");
+        deadline = GetCurrentMS() + timeout_ms;
+    }
+    std::vector<ChannelBase::WaitNode> nodes(m_cases.size());
+    while (true)
+    {
+        // FiberWaiter 只能被唤醒一次，每次挂起都使用新的等待者。定时器回调可能晚于本函数返回，共享所有权
+        auto waiter = std::make_shared<ChannelBase::Waiter>();
+        for (size_t i = 0; i < m_cases.size(); i++)
+        {
+            nodes[i].waiter = waiter.get();
+            nodes[i].index = static_cast<int>(i);
+            nodes[i].direction = m_cases[i].direction;
+            m_cases[i].channel->addWaitNode(&nodes[i]);
+        }
+        // 先登记、再重试，与 ChannelBase::wakeOne() 配对
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        index = trySelect();
+        Timer::ptr timer;
+        if (index < 0)
+        {
+            uint64_t now = iom ? GetCurrentMS() : 0;
+            if (iom && now >= deadline)
+            { // 已经超时，自己抢占唤醒权，抢不到说明有唤醒方正在唤醒自己
+                if (waiter->claimed.exchange(true, std::memory_order_acq_rel))
+                {
+                    waiter->waiter.wait();
+                }
+                else
+                {
+                    waiter->fired = ChannelBase::TIMED_OUT;
+                }
+            }
+            else
+            {
+                if (iom)
+                {
+                    timer = iom->addTimer(deadline - now, [waiter]() {
+                        if (!waiter->claimed.exchange(true, std::memory_order_acq_rel))
+                        {
+                            waiter->fired = ChannelBase::TIMED_OUT;
+                            waiter->waiter.notify();
+                        }
+                    });
+                }
+                waiter->waiter.wait();
+            }
+        }
+        else if (waiter->claimed.exchange(true, std::memory_order_acq_rel))
+        { // 重试成功，但已经有唤醒方抢到了唤醒权，必须消费掉这次唤醒
+            waiter->waiter.wait();
+        }
+        for (size_t i = 0; i < m_cases.size(); i++)
+        {
+            m_cases[i].channel->removeWaitNode(&nodes[i]);
+        }
+        if (timer)
+        {
+            timer->cancel();
+        }
+        int fired = waiter->fired;
+        if (index >= 0)
+        {
+            // 唤醒本来是给 fired 分支的，但完成的是其他分支，把唤醒转交给该通道的下一个等待者
+            if (fired >= 0 && fired != index)
+            {
+                m_cases[fired].channel->wakeOne(m_cases[fired].direction);
+            }
+            return index;
+        }
+        if (fired == ChannelBase::TIMED_OUT)
+        {
+            return -1;
+        }
+        // 优先尝试唤醒自己的分支，失败说明数据已经被其他协程抢走了，重新等待
+        if (attempt(fired))
+        {
+            return fired;
+        }
+        index = trySelect();
+        if (index >= 0)
+        {
+            return index;
+        }
+    }
+}
+
+} // namespace zjl
@@ -2,9 +2,14 @@
 #include "exception.h"
 #include "log.h"
 #include "scheduler.h"
+#include "stack_allocator.h"
+#include "util.h"
 #include <cassert>
 #include <cerrno>
+#include <csignal>
+#include <cstdlib>
 #include <cstring>
+#include <execinfo.h>
 #include <utility>
 
 namespace zjl
@@ -12,27 +17,108 @@ namespace zjl
 
 static Logger::ptr g_logger = GET_LOGGER("system");
 
+// 协程时间片，为 0 时 Fiber::maybeYield() 不让出
+static ConfigVar<uint64_t>::ptr g_fiber_time_slice_ms =
+    Config::Lookup<uint64_t>("fiber.time_slice_ms", 10, "time slice of Fiber::maybeYield()");
+
+// 时间片缓存，maybeYield() 调用频繁，不每次都读配置项
+static std::atomic_uint64_t s_time_slice_ns{0};
+struct _TimeSliceIniter
+{
+    _TimeSliceIniter()
+    {
+        s_time_slice_ns = g_fiber_time_slice_ms->getValue() * 1000000;
+        g_fiber_time_slice_ms->addListener([](const uint64_t& /*old_value*/, const uint64_t& new_value) {
+            s_time_slice_ns = new_value * 1000000;
+        });
+    }
+};
+static _TimeSliceIniter s_time_slice_initer;
+
+// 信号处理函数使用的备用栈大小，需要容纳日志输出与调用栈获取
+static constexpr size_t ALT_STACK_SIZE = 64 * 1024;
+// 安装栈溢出处理函数之前的 SIGSEGV 处理方式
+static struct sigaction s_old_segv_action;
+
 /**
- * @brief 对 malloc/free 简单封装的内存分配器
-*/
-class MallocStackAllocator
+ * @brief 线程的备用信号栈
+ * 协程栈溢出时栈已经用完，SIGSEGV 的处理函数只能在备用栈上执行
+ * */
+struct _AltStack
 {
-public:
-    static void* Alloc(uint64_t size)
+    _AltStack()
+        : memory(::malloc(ALT_STACK_SIZE))
     {
-        return ::malloc(size);
+        stack_t ss{};
+        ss.ss_sp = memory;
+        ss.ss_size = ALT_STACK_SIZE;
+        if (memory == nullptr || sigaltstack(&ss, nullptr))
+        {
+            ::free(memory);
+            memory = nullptr;
+        }
     }
 
-    static void Dealloc(void* ptr, uint64_t size)
+    ~_AltStack()
     {
-        free(ptr);
+        if (memory)
+        {
+            stack_t ss{};
+            ss.ss_flags = SS_DISABLE;
+            sigaltstack(&ss, nullptr);
+            ::free(memory);
+        }
     }
+
+    void* memory;
 };
 
-/**
- * @brief 协程栈空间分配器
-*/
-using StackAllocator = MallocStackAllocator;
+// SIGSEGV 的处理函数，访问地址位于当前协程栈的保护页时输出诊断信息并终止进程
+static void StackOverflowHandler(int sig, siginfo_t* info, void* context)
+{
+    Fiber* fiber = FiberInfo::t_fiber;
+    if (fiber && fiber->inGuardPage(info->si_addr))
+    {
+        // 进程即将终止，这里不再要求异步信号安全
+        LOG_FMT_FATAL(g_logger,
+                      "协程栈溢出，fiber_id = %lu, stack_size = %lu, addr = %p, call stack:\n%s",
+                      fiber->getID(), fiber->getStackSize(), info->si_addr,
+                      BacktraceToString().c_str());
+        ::abort();
+    }
+    // 其他原因的段错误交给原来的处理方式
+    if ((s_old_segv_action.sa_flags & SA_SIGINFO) && s_old_segv_action.sa_sigaction)
+    {
+        s_old_segv_action.sa_sigaction(sig, info, context);
+        return;
+    }
+    if (!(s_old_segv_action.sa_flags & SA_SIGINFO) &&
+        s_old_segv_action.sa_handler != SIG_DFL && s_old_segv_action.sa_handler != SIG_IGN)
+    {
+        s_old_segv_action.sa_handler(sig);
+        return;
+    }
+    // 恢复默认处理方式，返回后重新执行出错的指令，由默认处理方式终止进程
+    signal(SIGSEGV, SIG_DFL);
+}
+
+// 安装栈溢出处理函数，并给当前线程设置备用信号栈
+static void InstallOverflowHandler()
+{
+    static bool s_installed = []() {
+        // backtrace() 第一次调用时会加载 libgcc，提前调用
+        void* frames[1];
+        ::backtrace(frames, 1);
+        struct sigaction action{};
+        action.sa_sigaction = StackOverflowHandler;
+        action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+        sigemptyset(&action.sa_mask);
+        return sigaction(SIGSEGV, &action, &s_old_segv_action) == 0;
+    }();
+    static thread_local _AltStack t_alt_stack;
+    (void)s_installed;
+    (void)t_alt_stack;
+}
 
 /**
  * ===============================
@@ -48,12 +134,10 @@ Fiber::Fiber()
       m_stack(nullptr),
       m_callback()
 {
+    // master fiber 使用线程原有的栈，上下文在第一次换出时保存
     SetThis(this);
-    // 获取上下文对象的副本
-    if (getcontext(&m_ctx))
-    {
-        throw Exception(std::string(::strerror(errno)));
-    }
+    // 每个执行协程的线程都有 master fiber
+    InstallOverflowHandler();
     // 存在协程数量增加
     ++FiberInfo::s_fiber_count;
     LOG_FMT_DEBUG(g_logger,
@@ -61,31 +145,29 @@ Fiber::Fiber()
                   GetThreadID(), m_id);
 }
 
-Fiber::Fiber(FiberFunc callback, size_t stack_size)
+Fiber::Fiber(FiberFunc callback, size_t stack_size, bool shared_stack)
     : m_id(++FiberInfo::s_fiber_id),
-      m_stack_size(stack_size),
+      m_stack_size(shared_stack ? 0 : stack_size),
       m_state(INIT),
       m_ctx(),
       m_stack(nullptr),
+      m_shared(shared_stack),
       m_callback(std::move(callback))
 {
-    // 如果传入的 stack_size 为 0，使用配置项 "fiber.stack_size" 设置的值
-    if (m_stack_size == 0)
-    {
-        m_stack_size = FiberInfo::g_fiber_stack_size->getValue();
-    }
-    // 获取上下文对象的副本
-    if (getcontext(&m_ctx))
+    // 共享栈协程在第一次换入时才绑定栈、准备上下文
+    if (!m_shared)
     {
-        throw Exception(std::string(::strerror(errno)));
+        // 如果传入的 stack_size 为 0，使用配置项 "fiber.stack_size" 设置的值
+        if (m_stack_size == 0)
+        {
+            m_stack_size = FiberInfo::g_fiber_stack_size->getValue();
+        }
+        // 给上下文对象分配分配新的栈空间内存
+        m_allocator = StackAllocator::GetDefault();
+        m_stack = m_allocator->alloc(m_stack_size);
+        // 给新的上下文绑定入口函数
+        m_ctx.make(m_stack, m_stack_size, &Fiber::MainFunc);
     }
-    // 给上下文对象分配分配新的栈空间内存
-    m_stack = StackAllocator::Alloc(m_stack_size);
-    m_ctx.uc_link = nullptr;
-    m_ctx.uc_stack.ss_sp = m_stack;
-    m_ctx.uc_stack.ss_size = m_stack_size;
-    // 给新的上下文绑定入口函数
-    makecontext(&m_ctx, &Fiber::MainFunc, 0);
 
     ++FiberInfo::s_fiber_count;
 //    LOG_FMT_DEBUG(system_logger,
@@ -110,11 +192,14 @@ Fiber::~Fiber()
 //    LOG_FMT_DEBUG(system_logger,
 //                  "调用 Fiber::~Fiber 析构协程，thread_id = %ld, fiber_id = %ld",
 //                  GetThreadID(), m_id);
-    if (m_stack) // 存在栈，说明是子协程，释放申请的协程栈空间
+    if (m_stack || m_shared) // 存在栈，说明是子协程，释放申请的协程栈空间
     {
         // 只有子协程未被启动或者执行结束，才能被析构，否则属于程序错误
         assert(m_state == INIT || m_state == TERM || m_state == EXCEPTION);
-        StackAllocator::Dealloc(m_stack, m_stack_size);
+        if (m_stack)
+        {
+            m_allocator->dealloc(m_stack, m_stack_size);
+        }
     }
     else // 否则是 master fiber
     {
@@ -130,17 +215,15 @@ Fiber::~Fiber()
 
 void Fiber::reset(FiberFunc callback)
 {
-    assert(m_stack);
+    assert(m_stack || m_shared);
     assert(m_state == INIT || m_state == TERM || m_state == EXCEPTION);
     m_callback = std::move(callback);
-    if (getcontext(&m_ctx))
+    m_cancel_token.reset();
+    m_deadline_ms = 0;
+    if (m_stack)
     {
-        throw Exception(std::string(::strerror(errno)));
+        m_ctx.make(m_stack, m_stack_size, &Fiber::MainFunc);
     }
-    m_ctx.uc_link = nullptr;
-    m_ctx.uc_stack.ss_sp = m_stack;
-    m_ctx.uc_stack.ss_size = m_stack_size;
-    makecontext(&m_ctx, &Fiber::MainFunc, 0);
     m_state = INIT;
 }
 
@@ -150,74 +233,146 @@ void Fiber::swapIn()
     //           Scheduler::GetThis()->m_root_thread_id != GetThreadID());
     // 只有协程是等待执行的状态才能被换入
     assert(m_state == INIT || m_state == READY || m_state == HOLD);
+    bool acquired = tryAcquireStack();
+    assert(acquired && "共享栈正被其他协程使用");
     SetThis(this);
     m_state = EXEC;
     // 挂起 master fiber，切换到当前 fiber
     // if (swapcontext(&(FiberInfo::t_master_fiber->m_ctx), &m_ctx))
     assert(Scheduler::GetMainFiber() && "请勿手动调用该函数");
-    if (swapcontext(&(Scheduler::GetMainFiber()->m_ctx), &m_ctx))
-    {
-        throw Exception(std::string(::strerror(errno)));
-    }
+    FiberContext::Swap(Scheduler::GetMainFiber()->m_ctx, m_ctx);
+    releaseStack();
 }
 
 void Fiber::swapOut()
 {
     //    assert(Scheduler::GetThis()->m_root_thread_id == -1 ||
     //           Scheduler::GetThis()->m_root_thread_id != GetThreadID());
-    assert(m_stack);
+    assert(m_stack || m_shared);
     SetThis(FiberInfo::t_master_fiber.get());
     // 挂起当前 fiber，切换到 master fiber
     // if (swapcontext(&m_ctx, &(FiberInfo::t_master_fiber->m_ctx)))
     assert(Scheduler::GetMainFiber() && "请勿手动调用该函数");
-    if (swapcontext(&m_ctx, &(Scheduler::GetMainFiber()->m_ctx)))
-    {
-        throw Exception(std::string(::strerror(errno)));
-    }
+    FiberContext::Swap(m_ctx, Scheduler::GetMainFiber()->m_ctx);
 }
 
 void Fiber::call()
 {
     assert(FiberInfo::t_master_fiber && "当前线程不存在主协程");
     assert(m_state == INIT || m_state == READY || m_state == HOLD);
+    bool acquired = tryAcquireStack();
+    assert(acquired && "共享栈正被其他协程使用");
     SetThis(this);
     m_state = EXEC;
-    if (swapcontext(&(FiberInfo::t_master_fiber->m_ctx), &m_ctx))
-    {
-        throw Exception(std::string(::strerror(errno)));
-    }
+    FiberContext::Swap(FiberInfo::t_master_fiber->m_ctx, m_ctx);
+    releaseStack();
 }
 
 void Fiber::back()
 {
     assert(FiberInfo::t_master_fiber && "当前线程不存在主协程");
-    assert(m_stack);
+    assert(m_stack || m_shared);
     SetThis(FiberInfo::t_master_fiber.get());
-    if (swapcontext(&m_ctx, &(FiberInfo::t_master_fiber->m_ctx)))
-    {
-        throw Exception(std::string(::strerror(errno)));
-    }
+    FiberContext::Swap(m_ctx, FiberInfo::t_master_fiber->m_ctx);
 }
 
 void Fiber::swapIn(Fiber::ptr fiber)
 {
     assert(m_state == INIT || m_state == READY || m_state == HOLD);
+    bool acquired = tryAcquireStack();
+    assert(acquired && "共享栈正被其他协程使用");
     SetThis(this);
     m_state = EXEC;
-    if (swapcontext(&(fiber->m_ctx), &m_ctx))
-    {
-        throw Exception(std::string(::strerror(errno)));
-    }
+    FiberContext::Swap(fiber->m_ctx, m_ctx);
+    releaseStack();
 }
 
 void Fiber::swapOut(Fiber::ptr fiber)
 {
     assert(m_state);
     SetThis(fiber.get());
-    if (swapcontext(&m_ctx, &(fiber->m_ctx)))
+    FiberContext::Swap(m_ctx, fiber->m_ctx);
+}
+
+bool Fiber::inGuardPage(const void* addr) const
+{
+    const char* bottom = nullptr;
+    if (m_shared_stack)
     {
-        throw Exception(std::string(::strerror(errno)));
+        bottom = m_shared_stack->getBottom();
     }
+    else if (m_stack && m_allocator == MmapStackAllocator::GetInstance())
+    {
+        bottom = static_cast<const char*>(m_stack);
+    }
+    else
+    {
+        return false;
+    }
+    auto p = static_cast<const char*>(addr);
+    return p < bottom && p >= bottom - MmapStackAllocator::GuardSize();
+}
+
+bool Fiber::onSharedStack(const void* addr) const
+{
+    auto p = static_cast<const char*>(addr);
+    return m_shared_stack && p >= m_shared_stack->getBottom() && p < m_shared_stack->getTop();
+}
+
+bool Fiber::tryAcquireStack()
+{
+    if (!m_shared || finish())
+    {
+        return true;
+    }
+    if (!m_shared_stack)
+    {
+        m_shared_stack = SharedStack::Next();
+        m_stack_size = m_shared_stack->getSize();
+    }
+    if (!m_shared_stack->tryLock(this))
+    {
+        return false;
+    }
+    Fiber* occupant = m_shared_stack->getOccupant();
+    if (occupant == this)
+    {
+        return true;
+    }
+    if (occupant)
+    {
+        occupant->saveStack();
+    }
+    if (m_state == INIT)
+    {
+        m_ctx.make(m_shared_stack->getBottom(), m_shared_stack->getSize(), &Fiber::MainFunc);
+    }
+    else
+    {
+        ::memcpy(m_saved_sp, m_saved_stack.data(), m_saved_stack.size());
+    }
+    m_shared_stack->setOccupant(this);
+    return true;
+}
+
+void Fiber::releaseStack()
+{
+    if (m_shared_stack)
+    {
+        m_shared_stack->unlock();
+    }
+}
+
+void Fiber::saveStack()
+{
+    char* bottom = m_shared_stack->getBottom();
+    char* sp = static_cast<char*>(m_ctx.getSP());
+    if (sp == nullptr || sp < bottom)
+    {
+        sp = bottom;
+    }
+    m_saved_stack.assign(sp, m_shared_stack->getTop());
+    m_saved_sp = sp;
 }
 
 bool Fiber::finish() const noexcept
@@ -264,7 +419,9 @@ void Fiber::YieldToHold()
 {
     /* FIXME: 可能会造成 shared_ptr 的引用计数只增不减 */
     auto current_fiber = GetThis();
-    current_fiber->m_state = HOLD;
+    // 不在这里设置 HOLD：协程可能在换出之前就被其他线程唤醒并重新调度，
+    // 保持 EXEC 状态直到真正换出，由 Scheduler::run() 在换出后设置为 HOLD，
+    // 其他线程拿到仍处于 EXEC 状态的协程时会把它放回队列
     // if (Scheduler::GetThis() && Scheduler::GetThis()->m_root_thread_id == GetThreadID())
     // { // 调度器实例化时 use_caller 为 true, 并且当前协程所在的线程就是 root thread
     //     current_fiber->swapOut(FiberInfo::t_master_fiber);
@@ -273,6 +430,33 @@ void Fiber::YieldToHold()
     // {
     //     current_fiber->swapOut();
     // }
+    assert(current_fiber.get() != Scheduler::GetMainFiber() && "只有任务协程可以让出，scheduleInline() 的回调不能挂起");
+    current_fiber->swapOut();
+}
+
+bool Fiber::maybeYield()
+{
+    Fiber* current_fiber = FiberInfo::t_fiber;
+    // 只有调度器的任务协程可以让出
+    if (current_fiber == nullptr || current_fiber == Scheduler::GetMainFiber())
+    {
+        return false;
+    }
+    uint64_t time_slice_ns = s_time_slice_ns.load(std::memory_order_relaxed);
+    if (time_slice_ns == 0 || Scheduler::GetTaskRunTime() < time_slice_ns)
+    {
+        return false;
+    }
+    YieldToReady();
+    return true;
+}
+
+void Fiber::YieldToReady()
+{
+    Fiber* current_fiber = FiberInfo::t_fiber;
+    assert(current_fiber && current_fiber != Scheduler::GetMainFiber() && "只有任务协程可以让出");
+    // 换出前设置 READY 是安全的，协程在 Scheduler::run() 换回之后才会重新加入调度
+    current_fiber->m_state = READY;
     current_fiber->swapOut();
 }
 
@@ -318,6 +502,12 @@ void Fiber::MainFunc()
     }
     // 执行结束后，切回主协程
     Fiber* current_fiber_ptr = current_fiber.get();
+    // 栈上的内容不再需要保存
+    if (current_fiber_ptr->m_shared_stack)
+    {
+        current_fiber_ptr->m_shared_stack->setOccupant(nullptr);
+        std::vector<char>().swap(current_fiber_ptr->m_saved_stack);
+    }
     // 释放 shared_ptr 的所有权
     current_fiber.reset();
     if (Scheduler::GetThis() &&
@@ -334,4 +524,20 @@ void Fiber::MainFunc()
     assert(false && "协程已经结束");
 }
 
+DeadlineScope::DeadlineScope(uint64_t timeout_ms)
+    : m_fiber(Fiber::GetThis()),
+      m_previous(m_fiber->getDeadline())
+{
+    uint64_t deadline = GetCurrentMS() + timeout_ms;
+    if (m_previous == 0 || deadline < m_previous)
+    {
+        m_fiber->setDeadline(deadline);
+    }
+}
+
+DeadlineScope::~DeadlineScope()
+{
+    m_fiber->setDeadline(m_previous);
+}
+
 } // namespace zjl
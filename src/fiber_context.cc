@@ -0,0 +1,185 @@
+#include "fiber_context.h"
+#include "exception.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+ * =========================================
+ * 汇编上下文切换
+ * =========================================
+*/
+
+#if defined(__x86_64__)
+// System V ABI：rbx、rbp、r12-r15 由被调用者保存，另外保存 MXCSR 与 x87 控制字
+// 栈布局（从低地址到高地址）：mxcsr/fpucw、r12、r13、r14、r15、rbx、rbp、返回地址
+asm(R"(
+    .text
+    .globl zjl_swap_context
+    .type zjl_swap_context, @function
+    .align 16
+zjl_swap_context:
+    pushq %rbp
+    pushq %rbx
+    pushq %r15
+    pushq %r14
+    pushq %r13
+    pushq %r12
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r12
+    popq %r13
+    popq %r14
+    popq %r15
+    popq %rbx
+    popq %rbp
+    ret
+    .size zjl_swap_context, .-zjl_swap_context
+)");
+#elif defined(__aarch64__)
+// AAPCS64：x19-x28、fp(x29)、lr(x30) 与 d8-d15 由被调用者保存，共 160 字节
+asm(R"(
+    .text
+    .globl zjl_swap_context
+    .type zjl_swap_context, %function
+    .align 4
+zjl_swap_context:
+    sub sp, sp, #160
+    stp x19, x20, [sp, #0]
+    stp x21, x22, [sp, #16]
+    stp x23, x24, [sp, #32]
+    stp x25, x26, [sp, #48]
+    stp x27, x28, [sp, #64]
+    stp x29, x30, [sp, #80]
+    stp d8, d9, [sp, #96]
+    stp d10, d11, [sp, #112]
+    stp d12, d13, [sp, #128]
+    stp d14, d15, [sp, #144]
+    mov x9, sp
+    str x9, [x0]
+    mov sp, x1
+    ldp x19, x20, [sp, #0]
+    ldp x21, x22, [sp, #16]
+    ldp x23, x24, [sp, #32]
+    ldp x25, x26, [sp, #48]
+    ldp x27, x28, [sp, #64]
+    ldp x29, x30, [sp, #80]
+    ldp d8, d9, [sp, #96]
+    ldp d10, d11, [sp, #112]
+    ldp d12, d13, [sp, #128]
+    ldp d14, d15, [sp, #144]
+    add sp, sp, #160
+    ret
+    .size zjl_swap_context, .-zjl_swap_context
+)");
+#endif
+
+namespace zjl
+{
+
+#if defined(__x86_64__)
+void* MakeAsmContext(void* stack, size_t size, ContextEntry entry)
+{
+    auto top = (reinterpret_cast<uintptr_t>(stack) + size) & ~static_cast<uintptr_t>(15);
+    void** sp = reinterpret_cast<void**>(top);
+    // entry 的返回地址，entry 开始执行时 rsp 与普通函数调用后一样是 16n+8
+    *--sp = nullptr;
+    // zjl_swap_context 的 ret 跳转到 entry
+    *--sp = reinterpret_cast<void*>(entry);
+    // rbp、rbx、r15、r14、r13、r12
+    for (int i = 0; i < 6; i++)
+    {
+        *--sp = nullptr;
+    }
+    // 默认的 MXCSR 与 x87 控制字
+    --sp;
+    auto fpu = reinterpret_cast<uint32_t*>(sp);
+    fpu[0] = 0x1F80;
+    fpu[1] = 0x037F;
+    return sp;
+}
+#elif defined(__aarch64__)
+void* MakeAsmContext(void* stack, size_t size, ContextEntry entry)
+{
+    auto top = (reinterpret_cast<uintptr_t>(stack) + size) & ~static_cast<uintptr_t>(15);
+    void** sp = reinterpret_cast<void**>(top - 160);
+    ::memset(sp, 0, 160);
+    // lr 保存在偏移 88 处，zjl_swap_context 的 ret 跳转到 entry
+    sp[11] = reinterpret_cast<void*>(entry);
+    return sp;
+}
+#endif
+
+/**
+ * =========================================
+ * FiberContext 类的实现
+ * =========================================
+*/
+
+#if ZJL_FIBER_ASM_CONTEXT
+
+void FiberContext::make(void* stack, size_t size, ContextEntry entry)
+{
+    m_sp = MakeAsmContext(stack, size, entry);
+}
+
+void* FiberContext::getSP() const
+{
+    return m_sp;
+}
+
+const char* FiberContext::BackendName()
+{
+    return "asm";
+}
+
+#else
+
+void FiberContext::make(void* stack, size_t size, ContextEntry entry)
+{
+    // 获取上下文对象的副本
+    if (getcontext(&m_ctx))
+    {
+        throw Exception(std::string(::strerror(errno)));
+    }
+    m_ctx.uc_link = nullptr;
+    m_ctx.uc_stack.ss_sp = stack;
+    m_ctx.uc_stack.ss_size = size;
+    // 给新的上下文绑定入口函数
+    makecontext(&m_ctx, entry, 0);
+}
+
+void FiberContext::Swap(FiberContext& from, FiberContext& to)
+{
+    if (swapcontext(&from.m_ctx, &to.m_ctx))
+    {
+        throw Exception(std::string(::strerror(errno)));
+    }
+}
+
+void* FiberContext::getSP() const
+{
+#if defined(__x86_64__)
+    return reinterpret_cast<void*>(m_ctx.uc_mcontext.gregs[REG_RSP]);
+#elif defined(__aarch64__)
+    return reinterpret_cast<void*>(m_ctx.uc_mcontext.sp);
+#else
+    return nullptr;
+#endif
+}
+
+const char* FiberContext::BackendName()
+{
+    return "ucontext";
+}
+
+#endif
+
+} // namespace zjl
@@ -0,0 +1,420 @@
+#include "fiber_sync.h"
+#include "scheduler.h"
+#include <cassert>
+
+namespace zjl
+{
+
+/**
+ * =========================================
+ * FiberWaiter 类的实现
+ * =========================================
+*/
+
+FiberWaiter::FiberWaiter()
+    : m_semaphore(0)
+{
+    Scheduler* scheduler = Scheduler::GetThis();
+    if (scheduler && Fiber::GetFiberID() != 0)
+    {
+        Fiber::ptr fiber = Fiber::GetThis();
+        // 调度协程不能被挂起，只有任务协程才能让出
+        if (fiber.get() != Scheduler::GetMainFiber())
+        {
+            // 共享栈上的等待者在协程换出后会被其他协程覆盖，唤醒方无法再访问
+            assert(!fiber->onSharedStack(this) && "共享栈协程不能在栈上的等待者上挂起");
+            m_scheduler = scheduler;
+            m_fiber = std::move(fiber);
+        }
+    }
+}
+
+void FiberWaiter::wait()
+{
+    // 不能通过 m_fiber 判断，notify() 可能已经把它移走了
+    if (m_scheduler)
+    {
+        Fiber::YieldToHold();
+    }
+    else
+    {
+        m_semaphore.wait();
+    }
+}
+
+void FiberWaiter::notify()
+{
+    if (m_scheduler)
+    {
+        // 协程被重新调度后随时可能返回并销毁 this，之后不能再访问成员
+        Scheduler* scheduler = m_scheduler;
+        Fiber::ptr fiber = std::move(m_fiber);
+        scheduler->schedule(std::move(fiber));
+    }
+    else
+    {
+        m_semaphore.notify();
+    }
+}
+
+/**
+ * =========================================
+ * FiberWaitQueue 类的实现
+ * =========================================
+*/
+
+void FiberWaitQueue::push(FiberWaiter* waiter)
+{
+    waiter->next = nullptr;
+    if (m_tail)
+    {
+        m_tail->next = waiter;
+    }
+    else
+    {
+        m_head = waiter;
+    }
+    m_tail = waiter;
+}
+
+FiberWaiter* FiberWaitQueue::pop()
+{
+    FiberWaiter* waiter = m_head;
+    if (waiter)
+    {
+        m_head = waiter->next;
+        if (m_head == nullptr)
+        {
+            m_tail = nullptr;
+        }
+    }
+    return waiter;
+}
+
+FiberWaiter* FiberWaitQueue::popAll()
+{
+    FiberWaiter* head = m_head;
+    m_head = m_tail = nullptr;
+    return head;
+}
+
+// 唤醒链表中的所有等待者，先取出 next 再唤醒，唤醒后节点可能已经被销毁
+static void NotifyAll(FiberWaiter* waiter)
+{
+    while (waiter)
+    {
+        FiberWaiter* next = waiter->next;
+        waiter->notify();
+        waiter = next;
+    }
+}
+
+/**
+ * =========================================
+ * FiberMutex 类的实现
+ * =========================================
+*/
+
+void FiberMutex::lockSlow()
+{
+    while (true)
+    {
+        FiberWaiter waiter;
+        {
+            ScopedLock lock(&m_mutex);
+            // 标记有等待者，如果锁恰好被释放了，则直接获得锁
+            if (m_state.exchange(CONTENDED, std::memory_order_acquire) == UNLOCKED)
+            {
+                return;
+            }
+            m_waiters.push(&waiter);
+        }
+        waiter.wait();
+    }
+}
+
+void FiberMutex::unlockSlow()
+{
+    FiberWaiter* waiter = nullptr;
+    {
+        ScopedLock lock(&m_mutex);
+        waiter = m_waiters.pop();
+    }
+    // 被唤醒的协程重新竞争锁，不保证一定能拿到
+    if (waiter)
+    {
+        waiter->notify();
+    }
+}
+
+/**
+ * =========================================
+ * FiberCondVar 类的实现
+ * =========================================
+*/
+
+void FiberCondVar::wait(FiberMutex& mutex)
+{
+    FiberWaiter waiter;
+    {
+        // 入队时仍然持有 mutex，修改条件后再 notify 的协程不会错过这次等待
+        ScopedLock lock(&m_mutex);
+        m_waiters.push(&waiter);
+        ++m_waiter_count;
+    }
+    mutex.unlock();
+    waiter.wait();
+    mutex.lock();
+}
+
+void FiberCondVar::notifyOne()
+{
+    if (m_waiter_count.load(std::memory_order_acquire) == 0)
+    {
+        return;
+    }
+    FiberWaiter* waiter = nullptr;
+    {
+        ScopedLock lock(&m_mutex);
+        waiter = m_waiters.pop();
+        if (waiter)
+        {
+            --m_waiter_count;
+        }
+    }
+    if (waiter)
+    {
+        waiter->notify();
+    }
+}
+
+void FiberCondVar::notifyAll()
+{
+    if (m_waiter_count.load(std::memory_order_acquire) == 0)
+    {
+        return;
+    }
+    FiberWaiter* waiters = nullptr;
+    {
+        ScopedLock lock(&m_mutex);
+        waiters = m_waiters.popAll();
+        m_waiter_count = 0;
+    }
+    NotifyAll(waiters);
+}
+
+/**
+ * =========================================
+ * FiberSemaphore 类的实现
+ * =========================================
+*/
+
+bool FiberSemaphore::tryWait()
+{
+    int64_t count = m_count.load(std::memory_order_relaxed);
+    while (count > 0)
+    {
+        if (m_count.compare_exchange_weak(count, count - 1, std::memory_order_acquire))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void FiberSemaphore::waitSlow()
+{
+    FiberWaiter waiter;
+    {
+        ScopedLock lock(&m_mutex);
+        // notify() 在入队之前就到达了，不需要挂起
+        if (m_pending_wakeups > 0)
+        {
+            --m_pending_wakeups;
+            return;
+        }
+        m_waiters.push(&waiter);
+    }
+    waiter.wait();
+}
+
+void FiberSemaphore::notifySlow()
+{
+    FiberWaiter* waiter = nullptr;
+    {
+        ScopedLock lock(&m_mutex);
+        waiter = m_waiters.pop();
+        if (waiter == nullptr)
+        { // 等待者已经减少了计数，但还没有入队，留给它自己消费
+            ++m_pending_wakeups;
+            return;
+        }
+    }
+    waiter->notify();
+}
+
+/**
+ * =========================================
+ * FiberRWLock 类的实现
+ * =========================================
+*/
+
+void FiberRWLock::readLockSlow()
+{
+    while (true)
+    {
+        FiberWaiter waiter;
+        {
+            ScopedLock lock(&m_mutex);
+            uint32_t state = m_state.load(std::memory_order_relaxed);
+            while (true)
+            {
+                if ((state & WRITER) == 0 && m_waiting_writers == 0)
+                { // 没有写者持有或等待，直接获得读锁
+                    if (m_state.compare_exchange_weak(state, state + 1, std::memory_order_acquire))
+                    {
+                        return;
+                    }
+                    continue;
+                }
+                // 设置等待标记，之后持有锁的一方释放时会进入 wakeWaiters()
+                if (m_state.compare_exchange_weak(state, state | WAITERS, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            m_readers.push(&waiter);
+        }
+        waiter.wait();
+    }
+}
+
+void FiberRWLock::writeLockSlow()
+{
+    while (true)
+    {
+        FiberWaiter waiter;
+        {
+            ScopedLock lock(&m_mutex);
+            uint32_t state = m_state.load(std::memory_order_relaxed);
+            while (true)
+            {
+                if ((state & (WRITER | READER_MASK)) == 0)
+                { // 锁空闲，保留等待标记并获得写锁
+                    if (m_state.compare_exchange_weak(state, state | WRITER, std::memory_order_acquire))
+                    {
+                        return;
+                    }
+                    continue;
+                }
+                if (m_state.compare_exchange_weak(state, state | WAITERS, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            ++m_waiting_writers;
+            m_writers.push(&waiter);
+        }
+        waiter.wait();
+    }
+}
+
+void FiberRWLock::unlock()
+{
+    uint32_t state = m_state.load(std::memory_order_relaxed);
+    if (state & WRITER)
+    { // 持有写锁时没有读者，WRITER 位只会由自己清除
+        state = m_state.fetch_and(~WRITER, std::memory_order_release);
+        if (state & WAITERS)
+        {
+            wakeWaiters();
+        }
+    }
+    else
+    {
+        state = m_state.fetch_sub(1, std::memory_order_release);
+        // 最后一个读者负责唤醒
+        if ((state & READER_MASK) == 1 && (state & WAITERS))
+        {
+            wakeWaiters();
+        }
+    }
+}
+
+void FiberRWLock::wakeWaiters()
+{
+    FiberWaiter* waiters = nullptr;
+    {
+        ScopedLock lock(&m_mutex);
+        // 设置了 WAITERS 时加锁都要经过慢路径，这里看到的持有状态只会减少。
+        // 如果锁又被占用了，由持有者释放时负责唤醒
+        uint32_t state = m_state.load(std::memory_order_relaxed);
+        if (state & (WRITER | READER_MASK))
+        {
+            return;
+        }
+        // 写者优先，一次唤醒一个写者或所有读者
+        if (!m_writers.empty())
+        {
+            waiters = m_writers.pop();
+            waiters->next = nullptr;
+            --m_waiting_writers;
+        }
+        else
+        {
+            waiters = m_readers.popAll();
+        }
+        if (m_writers.empty() && m_readers.empty())
+        {
+            m_state.fetch_and(~WAITERS, std::memory_order_relaxed);
+        }
+    }
+    NotifyAll(waiters);
+}
+
+/**
+ * =========================================
+ * WaitGroup 类的实现
+ * =========================================
+*/
+
+void WaitGroup::wait()
+{
+    uint64_t state = m_state.load(std::memory_order_acquire);
+    if ((state >> 32) == 0)
+    {
+        return;
+    }
+    FiberWaiter waiter;
+    {
+        // 登记等待者与入队在同一把锁内，计数归零的一方看到等待者后加锁，一定能取到它
+        ScopedLock lock(&m_mutex);
+        while (true)
+        {
+            if ((state >> 32) == 0)
+            {
+                return;
+            }
+            if (m_state.compare_exchange_weak(state, state + 1, std::memory_order_acq_rel))
+            {
+                break;
+            }
+        }
+        m_waiters.push(&waiter);
+    }
+    waiter.wait();
+}
+
+void WaitGroup::wakeAll()
+{
+    FiberWaiter* waiters = nullptr;
+    {
+        ScopedLock lock(&m_mutex);
+        // 计数为零时不会有新的等待者登记，清零等待者数量后可以重复使用
+        m_state.store(0, std::memory_order_release);
+        waiters = m_waiters.popAll();
+    }
+    NotifyAll(waiters);
+}
+
+} // namespace zjl
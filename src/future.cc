@@ -0,0 +1,41 @@
+#include "future.h"
+
+namespace zjl
+{
+
+/**
+ * =========================================
+ * FutureStateBase 类的实现
+ * =========================================
+*/
+
+void FutureStateBase::markReady(ScopedLock& lock)
+{
+    m_satisfied = true;
+    m_ready.store(true, std::memory_order_release);
+    FiberWaiter* waiter = m_waiters.popAll();
+    lock.unlock();
+    // 先取出 next 再唤醒，唤醒后节点可能已经被销毁
+    while (waiter)
+    {
+        FiberWaiter* next = waiter->next;
+        waiter->notify();
+        waiter = next;
+    }
+}
+
+void FutureStateBase::waitSlow()
+{
+    FiberWaiter waiter;
+    {
+        ScopedLock lock(&m_mutex);
+        if (m_satisfied)
+        {
+            return;
+        }
+        m_waiters.push(&waiter);
+    }
+    waiter.wait();
+}
+
+} // namespace zjl
@@ -4,6 +4,9 @@
 #include "log.h"
 #include "fd_manager.h"
 #include "config.h"
+#include "task_group.h"
+#include <algorithm>
+#include <atomic>
 
 namespace zjl
 {
@@ -82,6 +85,137 @@ struct TimerInfo
     int cancelled = 0;
 };
 
+/**
+ * 协程挂起后可能在另一条线程上恢复，而 __errno_location() 被声明为 const，
+ * 编译器会复用挂起前取得的 errno 地址，读写到原线程的 errno 上。
+ * 挂起之后统一通过这两个不内联的函数访问 errno
+*/
+static __attribute__((noinline)) int getErrno()
+{
+    return errno;
+}
+
+static __attribute__((noinline)) void setErrno(int error)
+{
+    errno = error;
+}
+
+/**
+ * @brief 当前协程距离截止时间的剩余毫秒数
+ * @return 没有设置截止时间时返回 -1，已经超过截止时间时返回 0
+*/
+static uint64_t deadlineBudget()
+{
+    // 没有协程时不创建 master fiber
+    if (zjl::Fiber::GetFiberID() == 0)
+    {
+        return -1;
+    }
+    uint64_t deadline = zjl::Fiber::GetThis()->getDeadline();
+    if (deadline == 0)
+    {
+        return -1;
+    }
+    uint64_t now = zjl::GetCurrentMS();
+    return deadline > now ? deadline - now : 0;
+}
+
+/**
+ * @brief 在取消令牌上注册回调，令牌取消时记录原因，并取消 fd 上的事件监听，使等待中的协程立刻恢复
+ * @return 回调 id，没有令牌时返回 0
+*/
+static uint64_t addCancelListener(const zjl::CancelToken::ptr& token, const std::shared_ptr<TimerInfo>& timer_info,
+                                  zjl::IOManager* iom, int fd, zjl::FDEventType event)
+{
+    if (!token)
+    {
+        return 0;
+    }
+    zjl::CancelToken* raw_token = token.get();
+    return token->addCallback([raw_token, timer_info, iom, fd, event](){
+        if (!timer_info->cancelled)
+        {
+            timer_info->cancelled = raw_token->reason();
+        }
+        iom->cancelEventListener(fd, event);
+    });
+}
+
+/**
+ * @brief 当前调度器的定时器，IOManager 和 SimScheduler 都带有定时器，没有时返回 nullptr
+*/
+static zjl::TimerManager* getTimerManager()
+{
+    return dynamic_cast<zjl::TimerManager*>(zjl::Scheduler::GetThis());
+}
+
+/**
+ * @brief 用定时器挂起当前协程指定的毫秒数，当前协程的取消令牌被取消时提前恢复
+ * 超过当前协程的截止时间时只睡到截止时间
+ * @return 被取消时返回 false，errno 为取消原因；被截止时间截断时返回 false，errno 为 ETIMEDOUT
+*/
+static bool doSleep(uint64_t ms)
+{
+    zjl::Fiber::ptr fiber = zjl::Fiber::GetThis();
+    zjl::Scheduler* scheduler = zjl::Scheduler::GetThis();
+    zjl::TimerManager* timers = getTimerManager();
+    assert(timers != nullptr && "当前调度器没有定时器");
+    zjl::CancelToken::ptr token = fiber->getCancelToken();
+    if (token && token->isCancelled())
+    {
+        errno = token->reason();
+        return false;
+    }
+    uint64_t budget = deadlineBudget();
+    if (budget == 0)
+    {
+        errno = ETIMEDOUT;
+        return false;
+    }
+    bool truncated = budget < ms;
+    if (truncated)
+    {
+        ms = budget;
+    }
+    // 定时器与取消回调只有先到的一方恢复协程，1 表示定时器，2 表示取消
+    auto resumed_by = std::make_shared<std::atomic_int>(0);
+    zjl::Timer::ptr timer = timers->addTimer(ms, [scheduler, fiber, resumed_by](){
+        int expected = 0;
+        if (resumed_by->compare_exchange_strong(expected, 1))
+        {
+            scheduler->schedule(fiber);
+        }
+    });
+    uint64_t cancel_id = 0;
+    if (token)
+    {
+        cancel_id = token->addCallback([scheduler, fiber, resumed_by, timer](){
+            int expected = 0;
+            if (resumed_by->compare_exchange_strong(expected, 2))
+            {
+                timer->cancel();
+                scheduler->schedule(fiber);
+            }
+        });
+    }
+    zjl::Fiber::YieldToHold();
+    if (token)
+    {
+        token->removeCallback(cancel_id);
+    }
+    if (*resumed_by == 2)
+    {
+        setErrno(token->reason());
+        return false;
+    }
+    if (truncated)
+    {
+        setErrno(ETIMEDOUT);
+        return false;
+    }
+    return true;
+}
+
 template<typename OriginFunc, typename ...Args>
 static ssize_t doIO(int fd, OriginFunc func, const char* hook_func_name, 
                     uint32_t event, int fd_timeout_type, Args&& ...args)
@@ -114,23 +248,38 @@ RETRY:
     ssize_t n = func(fd, std::forward<Args>(args)...);
     // 出现错误 EINTR，是因为系统 API 在阻塞等待状态下被其他的系统信号中断执行
     // 此处的解决办法就是重新调用这次系统 API
-    while(n == -1 && errno == EINTR)
+    while(n == -1 && getErrno() == EINTR)
     {        
         n = func(fd, std::forward<Args>(args)...);
     }
     // 出现错误 EAGAIN，是因为长时间未读到数据或者无法写入数据，直接把这个 fd 丢到 IOManager 里监听对应事件，触发后返回本执行上下文 
-    if (n == -1 && errno == EAGAIN)
+    if (n == -1 && getErrno() == EAGAIN)
     {
         LOG_FMT_DEBUG(zjl::system_logger, "doIO(%s): 开始异步等待", hook_func_name);
 
+        // 所在的任务组已经取消，不再等待
+        zjl::CancelToken::ptr token = zjl::CancelToken::GetThis();
+        if (token && token->isCancelled())
+        {
+            setErrno(token->reason());
+            return -1;
+        }
+        // 每次重新等待前都检查截止时间，等待时间取 fd 超时与剩余预算中较小的一个
+        uint64_t budget = deadlineBudget();
+        if (budget == 0)
+        {
+            setErrno(ETIMEDOUT);
+            return -1;
+        }
+        uint64_t wait_ms = std::min(timeout, budget);
         auto iom = zjl::IOManager::GetThis();
         zjl::Timer::ptr timer;
         std::weak_ptr<TimerInfo> timer_info_wp(timer_info);
         // 如果设置了超时时间，在指定时间后取消掉该 fd 的事件监听
-        if (timeout != static_cast<uint64_t>(-1))
+        if (wait_ms != static_cast<uint64_t>(-1))
         {
             timer = iom->addConditionTimer(
-                timeout, 
+                wait_ms, 
                 [timer_info_wp, fd, iom, event](){
                     auto t = timer_info_wp.lock();
                     if (!t || t->cancelled)
@@ -155,15 +304,20 @@ RETRY:
             }
             return -1;
         }
+        uint64_t cancel_id = addCancelListener(token, timer_info, iom, fd, static_cast<zjl::FDEventType>(event));
         zjl::Fiber::YieldToHold();
 
+        if (token)
+        {
+            token->removeCallback(cancel_id);
+        }
         if (timer)
         {
             timer->cancel();
         }
         if (timer_info->cancelled)
         {
-            errno = timer_info->cancelled;
+            setErrno(timer_info->cancelled);
             return -1;
         }
         goto RETRY;
@@ -183,18 +337,13 @@ extern "C"
 */
 unsigned int sleep(unsigned int seconds)
 {
-    if (!zjl::t_hook_enabled)
+    // 调度器已经析构，或者不带定时器时直接调用系统函数
+    if (!zjl::t_hook_enabled || !getTimerManager())
     {
         return sleep_f(seconds);
     }
-    zjl::Fiber::ptr fiber = zjl::Fiber::GetThis();
-    auto iom = zjl::IOManager::GetThis();
-    assert(iom != nullptr && "这里的 IOManager 指针不可为空");
-    iom->addTimer(seconds * 1000, [iom, fiber](){
-        iom->schedule(fiber);
-    });
-    zjl::Fiber::YieldToHold();
-    return 0;
+    // 被取消时返回未睡眠的秒数
+    return doSleep(seconds * 1000ull) ? 0 : seconds;
 }
 
 /**
@@ -202,35 +351,29 @@ unsigned int sleep(unsigned int seconds)
 */
 int usleep(useconds_t usec)
 {
-    if (!zjl::t_hook_enabled)
+    if (!zjl::t_hook_enabled || !getTimerManager())
     {
         return usleep_f(usec);
     }
-    zjl::Fiber::ptr fiber = zjl::Fiber::GetThis();
-    auto iom = zjl::IOManager::GetThis();
-    assert(iom != nullptr && "这里的 IOManager 指针不可为空");
-    iom->addTimer(usec / 1000, [iom, fiber](){
-        iom->schedule(fiber);
-    });
-    zjl::Fiber::YieldToHold();
-    return 0;
+    return doSleep(usec / 1000) ? 0 : -1;
 }
 
 int nanosleep(const struct timespec *req, struct timespec *rem)
 {
-    if (!zjl::t_hook_enabled)
+    if (!zjl::t_hook_enabled || !getTimerManager())
     {
         return nanosleep_f(req, rem);
     }
     int timeout_ms = req->tv_sec * 1000 + req->tv_nsec / 1000 / 1000;
-    zjl::Fiber::ptr fiber = zjl::Fiber::GetThis();
-    auto iom = zjl::IOManager::GetThis();
-    assert(iom != nullptr && "这里的 IOManager 指针不可为空");
-    iom->addTimer(timeout_ms, [iom, fiber](){
-        iom->schedule(fiber);
-    });
-    zjl::Fiber::YieldToHold();
-    return 0;
+    if (doSleep(timeout_ms))
+    {
+        return 0;
+    }
+    if (rem)
+    {
+        *rem = *req;
+    }
+    return -1;
 }
 
 //////// sys/socket.h
@@ -283,6 +426,19 @@ int connectWithTimeout(int sockfd, const struct sockaddr *addr, socklen_t addrle
      * 调用 connect，非阻塞形式下会返回-1，但是 errno 被设为 EINPROGRESS，表明 connect 仍旧在进行还没有完成。
      * 下一步就需要为其添加 write 事件监听，当连接成功后会触发该事件。
     */
+    zjl::CancelToken::ptr token = zjl::CancelToken::GetThis();
+    if (token && token->isCancelled())
+    {
+        errno = token->reason();
+        return -1;
+    }
+    uint64_t budget = deadlineBudget();
+    if (budget == 0)
+    {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    timeout_ms = std::min(timeout_ms, budget);
     auto iom = zjl::IOManager::GetThis();
     zjl::Timer::ptr timer;
     auto timer_info = std::make_shared<TimerInfo>();
@@ -307,14 +463,19 @@ int connectWithTimeout(int sockfd, const struct sockaddr *addr, socklen_t addrle
     int rt = iom->addEventListener(sockfd, zjl::FDEventType::WRITE);
     if (rt == 0)
     {
+        uint64_t cancel_id = addCancelListener(token, timer_info, iom, sockfd, zjl::FDEventType::WRITE);
         zjl::Fiber::YieldToHold();
+        if (token)
+        {
+            token->removeCallback(cancel_id);
+        }
         if (timer)
         {
             timer->cancel();
         }
         if (timer_info->cancelled)
         {
-            errno = timer_info->cancelled;
+            setErrno(timer_info->cancelled);
             return -1;
         }
     }
@@ -340,7 +501,7 @@ int connectWithTimeout(int sockfd, const struct sockaddr *addr, socklen_t addrle
     }
     else 
     {
-        errno = error;
+        setErrno(error);
         return -1;    
     }
 }
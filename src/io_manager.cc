@@ -1,18 +1,79 @@
 #include "io_manager.h"
+#include "config.h"
 #include "exception.h"
 #include "log.h"
+#include <algorithm>
 #include <array>
+#include <cerrno>
+#include <csignal>
 #include <cstring>
 #include <fcntl.h>
+#include <iterator>
 #include <memory>
+#include <pthread.h>
+#include <sched.h>
 #include <string>
 #include <sys/epoll.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 namespace zjl
 {
 
 static Logger::ptr system_logger = GET_LOGGER("system");
+// 调度线程空闲后，进入 epoll_wait 之前最多自旋等待的时间，为 0 时不自旋
+static ConfigVar<int>::ptr g_idle_spin_us =
+    Config::Lookup("iomanager.idle_spin_us", 50, "max spin time before epoll_wait in us");
+// 自旋时先执行若干轮 pause 指令，之后每轮让出 CPU
+static constexpr uint64_t SPIN_PAUSE_ROUNDS = 64;
+
+/**
+ * 定向唤醒调度线程使用的信号。管道由所有线程共享，写入的数据可能被其他空闲线程读走，
+ * 绑定在某条线程上的任务只能用信号打断目标线程的 epoll_pwait。
+ * 调度线程平时屏蔽该信号，只在 epoll_pwait 期间接收，不会打断任务中的系统调用。
+ * 看门狗用 SIGURG 采样调用栈，任务执行期间不能屏蔽，这里使用一个实时信号
+ * */
+static int WakeupSignal()
+{
+    return SIGRTMIN + 2;
+}
+
+static void WakeupHandler(int) {}
+
+// 实时信号的默认动作是终止进程，需要安装处理函数；用户已经安装了处理函数时保留用户的
+static void InstallWakeupHandler()
+{
+    static bool s_installed = []() {
+        struct sigaction old_action{};
+        if (sigaction(WakeupSignal(), nullptr, &old_action) == -1)
+        {
+            return false;
+        }
+        bool user_handler = (old_action.sa_flags & SA_SIGINFO)
+            ? old_action.sa_sigaction != nullptr
+            : old_action.sa_handler != SIG_DFL && old_action.sa_handler != SIG_IGN;
+        if (user_handler)
+        {
+            return true;
+        }
+        struct sigaction action{};
+        action.sa_handler = WakeupHandler;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        return sigaction(WakeupSignal(), &action, nullptr) == 0;
+    }();
+    (void)s_installed;
+}
+
+// 提示 CPU 当前处于自旋等待中
+static inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
 
 /**
  * ===================================================
@@ -29,8 +90,9 @@ IOManager* IOManager::GetThis()
     return dynamic_cast<IOManager*>(Scheduler::GetThis());
 }
 
-IOManager::IOManager(size_t thread_size, bool use_caller, std::string name)
-    : Scheduler(thread_size, use_caller, std::move(name))
+IOManager::IOManager(size_t thread_size, bool use_caller, std::string name,
+                     ThreadAffinity affinity)
+    : Scheduler(thread_size, use_caller, std::move(name), std::move(affinity))
 {
     LOG_DEBUG(system_logger, "调用 IOManager::IOManager()");
     // 创建 epoll
@@ -59,6 +121,7 @@ IOManager::IOManager(size_t thread_size, bool use_caller, std::string name)
         THROW_EXCEPTION_WHIT_ERRNO;
     }
     contextListResize(64);
+    InstallWakeupHandler();
     // 启动调度器
     start();
 }
@@ -247,7 +310,7 @@ bool IOManager::cancelEventListener(int fd, FDEventType event)
             m_epoll_fd);
         THROW_EXCEPTION_WHIT_ERRNO;
     }
-    fd_ctx->m_events = new_event;
+    // triggerEvent() 会从 m_events 中清除该事件
     fd_ctx->triggerEvent(event);
     --m_pending_event_count;
     return true;
@@ -296,7 +359,8 @@ bool IOManager::cancelAll(int fd)
 
 void IOManager::tickle()
 {
-    if (hasIdleThread())
+    // 没有空闲线程，或者有线程正在自旋，都不需要通过管道唤醒
+    if (!hasIdleThread() || m_spinning)
     {
         return;
     }
@@ -306,6 +370,16 @@ void IOManager::tickle()
     }
 }
 
+void IOManager::tickleThread(long thread_id)
+{
+    // 线程可能已经退出；实时信号排队，队列满时目标线程已经有待处理的唤醒
+    if (::syscall(SYS_tgkill, ::getpid(), thread_id, WakeupSignal()) == -1 &&
+        errno != ESRCH && errno != EAGAIN)
+    {
+        throw zjl::SystemError("唤醒调度线程失败");
+    }
+}
+
 bool IOManager::isStop()
 {
     uint64_t timeout;
@@ -320,10 +394,70 @@ bool IOManager::isStop(uint64_t& timeout)
         Scheduler::isStop();
 }
 
+bool IOManager::spinForTask()
+{
+    int spin_us = g_idle_spin_us->getValue();
+    if (spin_us <= 0)
+    {
+        return false;
+    }
+    // 已经有线程在自旋
+    bool expected = false;
+    if (m_spinning.load(std::memory_order_relaxed) ||
+        !m_spinning.compare_exchange_strong(expected, true))
+    {
+        return false;
+    }
+    uint64_t max_ns = static_cast<uint64_t>(spin_us) * 1000;
+    uint64_t min_ns = std::max<uint64_t>(max_ns / 32, 1);
+    uint64_t budget = m_spin_budget_ns.load(std::memory_order_relaxed);
+    budget = std::min(std::max(budget, min_ns), max_ns);
+    bool found = false;
+    uint64_t begin = GetCurrentNS();
+    for (uint64_t i = 0; !found; i++)
+    {
+        if (hasRunnableTask())
+        {
+            found = true;
+        }
+        else if (GetCurrentNS() - begin >= budget)
+        {
+            break;
+        }
+        else if (i < SPIN_PAUSE_ROUNDS)
+        {
+            CpuRelax();
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+    // 等到了任务说明任务来得密集，下次多自旋一会儿，否则缩短自旋时间
+    m_spin_budget_ns.store(found ? std::min(budget * 2, max_ns) : std::max(budget / 2, min_ns),
+                           std::memory_order_relaxed);
+    // 先清除自旋标记，再检查任务数量，与 tickle() 中的先放入任务再检查自旋标记对应，不会漏掉唤醒
+    m_spinning = false;
+    // 自旋线程只能处理一个任务，任务较多时再唤醒一条线程
+    if (found && m_task_count > 1)
+    {
+        tickle();
+    }
+    return found;
+}
+
 void IOManager::onIdle()
 {
     LOG_DEBUG(system_logger, "调用 IOManager::onIdle()");
     auto event_list = std::make_unique<epoll_event[]>(64);
+    sigset_t wakeup_set;
+    sigemptyset(&wakeup_set);
+    sigaddset(&wakeup_set, WakeupSignal());
+    sigset_t old_mask;
+    pthread_sigmask(SIG_BLOCK, &wakeup_set, &old_mask);
+    // epoll_pwait 期间使用的信号掩码，只放开唤醒信号
+    sigset_t wait_mask = old_mask;
+    sigdelset(&wait_mask, WakeupSignal());
 
     while (true)
     {
@@ -338,6 +472,21 @@ void IOManager::onIdle()
                 break;
             }
         }
+        // 线程池缩容，当前线程即将退出
+        if (isRetiring())
+        {
+            break;
+        }
+
+        // 先自旋等待一小段时间，任务很快到来时不需要经过管道和 epoll_wait 唤醒；
+        // 已经有任务时只非阻塞地检查一次 IO 事件和定时器
+        bool has_task = spinForTask() || hasRunnableTask();
+        if (!has_task)
+        {
+            // 先标记阻塞再检查一次，投递到信箱的任务要么在这里被发现，要么通过信号唤醒
+            setSleeping(true);
+            has_task = hasRunnableTask();
+        }
 
         int result = 0;
         while (true)
@@ -353,9 +502,15 @@ void IOManager::onIdle()
                 next_timeout = MAX_TIMEOUT;
             }
             // 阻塞等待 epoll 返回结果
-            result = ::epoll_wait(m_epoll_fd, event_list.get(), 64, static_cast<int>(next_timeout));
+            result = ::epoll_pwait(m_epoll_fd, event_list.get(), 64,
+                                   has_task ? 0 : static_cast<int>(next_timeout), &wait_mask);
             
-            if (result < 0 /*&& errno == EINTR*/)
+            if (result < 0 && errno == EINTR)
+            { // 被唤醒信号打断，回到调度器查看信箱
+                result = 0;
+                break;
+            }
+            if (result < 0)
             {
                 // TODO 处理 epoll_wait 异常
             }
@@ -364,13 +519,15 @@ void IOManager::onIdle()
                 break;
             }
         }
+        setSleeping(false);
         
         // 处理定时器
         std::vector<std::function<void()>> fns;
         listExpiredCallback(fns);
         if (!fns.empty())
         {
-            schedule(fns.begin(), fns.end());
+            schedule(std::make_move_iterator(fns.begin()),
+                     std::make_move_iterator(fns.end()));
         }
 
         // 遍历 event_list 处理被触发事件的 fd
@@ -407,6 +564,8 @@ void IOManager::onIdle()
             {
                 real_events |= FDEventType::WRITE;
             }
+            // 出错时 epoll 会同时报告读写事件，只处理实际注册过的事件
+            real_events &= fd_ctx->m_events;
             // fd_ctx 中指定监听的事件都已经被触发并处理
             if ((fd_ctx->m_events & real_events) == FDEventType::NONE)
             {
@@ -444,6 +603,7 @@ void IOManager::onIdle()
         current_fiber.reset();
         raw_ptr->swapOut();
     }
+    pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
 }
 
 void IOManager::onTimerInsertedAtFirst()
@@ -488,14 +648,14 @@ void FDContext::triggerEvent(FDEventType type)
     m_events = static_cast<FDEventType>(m_events & ~type);
     auto& handler = getEventHandler(type);
     assert(handler.m_scheduler);
-    // 安排！
+    // 安排！IO 事件就绪后恢复的任务对延迟敏感，使用高优先级
     if (handler.m_fiber)
     {
-        handler.m_scheduler->schedule(std::move(handler.m_fiber));
+        handler.m_scheduler->schedule(std::move(handler.m_fiber), -1, Scheduler::PRIORITY_HIGH);
     }
     else if (handler.m_callback)
     {
-        handler.m_scheduler->schedule(std::move(handler.m_callback));
+        handler.m_scheduler->schedule(std::move(handler.m_callback), -1, Scheduler::PRIORITY_HIGH);
     }
     handler.m_scheduler = nullptr;
 }
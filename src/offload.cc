@@ -0,0 +1,153 @@
+#include "offload.h"
+#include "config.h"
+#include "log.h"
+#include "util.h"
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+
+namespace zjl
+{
+
+static Logger::ptr system_logger = GET_LOGGER("system");
+// 默认卸载线程池的线程数量
+static ConfigVar<int>::ptr g_offload_threads =
+    Config::Lookup("offload.threads", 4, "thread count of the default offload pool");
+// 默认卸载线程池的等待队列容量
+static ConfigVar<int>::ptr g_offload_queue_capacity =
+    Config::Lookup("offload.queue_capacity", 1024, "queue capacity of the default offload pool");
+
+/**
+ * =========================================
+ * OffloadPool::Stats 的实现
+ * =========================================
+*/
+
+double OffloadPool::Stats::meanQueueDelay() const
+{
+    return completed ? static_cast<double>(queue_delay_ns) / completed : 0;
+}
+
+std::string OffloadPool::Stats::toString() const
+{
+    std::stringstream ss;
+    ss << "等待任务数=" << queue_depth
+       << " 最大等待任务数=" << max_queue_depth
+       << " 执行中=" << running
+       << " 提交=" << submitted
+       << " 完成=" << completed
+       << " 等待空位=" << blocked
+       << " 拒绝=" << rejected
+       << " 平均排队时间=" << static_cast<uint64_t>(meanQueueDelay()) << "ns";
+    return ss.str();
+}
+
+/**
+ * =========================================
+ * OffloadPool 类的实现
+ * =========================================
+*/
+
+OffloadPool::OffloadPool(size_t thread_count, size_t queue_capacity, const std::string& name)
+    : m_name(name),
+      m_slots(static_cast<int64_t>(queue_capacity > 0 ? queue_capacity : 1)),
+      m_items(0)
+{
+    thread_count = thread_count > 0 ? thread_count : 1;
+    m_threads.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        m_threads.push_back(std::make_shared<Thread>(
+            [this]() { run(); }, m_name + "_" + std::to_string(i)));
+    }
+}
+
+OffloadPool::~OffloadPool()
+{
+    {
+        ScopedLock lock(&m_mutex);
+        m_stopping = true;
+    }
+    // 每条线程一个结束通知，线程取完剩余的任务后，看到空队列时退出
+    for (size_t i = 0; i < m_threads.size(); i++)
+    {
+        m_items.notify();
+    }
+    for (auto& thread : m_threads)
+    {
+        thread->join();
+    }
+}
+
+void OffloadPool::enqueue(InlineFunction<64> callback)
+{
+    size_t depth = 0;
+    {
+        ScopedLock lock(&m_mutex);
+        assert(!m_stopping && "卸载线程池已经停止");
+        m_tasks.push_back(Task{std::move(callback), GetCurrentNS()});
+        depth = m_tasks.size();
+    }
+    ++m_submitted;
+    uint64_t max_depth = m_max_queue_depth.load(std::memory_order_relaxed);
+    while (depth > max_depth &&
+           !m_max_queue_depth.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed))
+    {
+    }
+    m_items.notify();
+}
+
+void OffloadPool::run()
+{
+    while (true)
+    {
+        m_items.wait();
+        Task task;
+        {
+            ScopedLock lock(&m_mutex);
+            if (m_tasks.empty())
+            { // 只有停止时才会在队列为空时被唤醒
+                break;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        // 空出位置，唤醒一个等待提交的协程
+        m_slots.notify();
+        m_queue_delay_ns += GetCurrentNS() - task.enqueue_ns;
+        ++m_running;
+        // 结果与异常由任务内的 Promise 传递给等待的协程
+        task.callback();
+        task.callback = nullptr;
+        --m_running;
+        ++m_completed;
+    }
+    LOG_FMT_DEBUG(system_logger, "卸载线程池 %s 的线程 %ld 退出", m_name.c_str(), GetThreadID());
+}
+
+OffloadPool::Stats OffloadPool::getStats() const
+{
+    Stats stats;
+    {
+        ScopedLock lock(&m_mutex);
+        stats.queue_depth = m_tasks.size();
+    }
+    stats.max_queue_depth = m_max_queue_depth;
+    stats.running = m_running;
+    stats.submitted = m_submitted;
+    stats.completed = m_completed;
+    stats.blocked = m_blocked;
+    stats.rejected = m_rejected;
+    stats.queue_delay_ns = m_queue_delay_ns;
+    return stats;
+}
+
+OffloadPool* OffloadPool::GetDefault()
+{
+    static OffloadPool s_pool(static_cast<size_t>(std::max(g_offload_threads->getValue(), 1)),
+                              static_cast<size_t>(std::max(g_offload_queue_capacity->getValue(), 1)),
+                              "offload");
+    return &s_pool;
+}
+
+} // namespace zjl
@@ -1,15 +1,281 @@
 #include "scheduler.h"
+#include "config.h"
 #include "log.h"
 #include "hook.h"
+#include "watchdog.h"
+#include <algorithm>
+#include <sstream>
 
 namespace zjl
 {
 
 static Logger::ptr system_logger = GET_LOGGER("system");
+// 高、普通、低优先级的调度权重，例如 {8, 4, 1} 表示每 13 次取任务中分别优先选择 8、4、1 次
+static ConfigVar<std::vector<int>>::ptr g_scheduler_priority_weights =
+    Config::Lookup("scheduler.priority_weights", std::vector<int>{8, 4, 1},
+                   "scheduler priority weights (high, normal, low)");
+// 从普通优先级的共享队列取任务时，每次加锁最多取出的任务数量，为 1 时每次只取一个
+static ConfigVar<int>::ptr g_scheduler_batch_size =
+    Config::Lookup("scheduler.batch_size", 32, "max tasks taken from the shared queue per lock");
+// 每条调度线程缓存的执行结束的回调任务协程数量，为 0 时每个回调任务都创建新协程
+static ConfigVar<int>::ptr g_scheduler_fiber_cache_size =
+    Config::Lookup("scheduler.fiber_cache_size", 16, "finished callback fibers cached per worker for reuse");
+// 各调度器的调度线程数量，键为调度器名称，修改后线程数量随之调整
+static ConfigVar<std::map<std::string, int>>::ptr g_scheduler_threads =
+    Config::Lookup("scheduler.threads", std::map<std::string, int>{},
+                   "thread count of schedulers, keyed by scheduler name");
+// 线程池线程数量的上限，构造调度器时按上限预留工作队列
+static ConfigVar<int>::ptr g_scheduler_max_threads =
+    Config::Lookup("scheduler.max_threads", 64, "max pool threads of a scheduler");
+// 各调度器线程池绑定的 CPU 列表，键为调度器名称
+static ConfigVar<std::map<std::string, std::vector<int>>>::ptr g_scheduler_cpus =
+    Config::Lookup("scheduler.cpus", std::map<std::string, std::vector<int>>{},
+                   "cpus of scheduler workers, keyed by scheduler name");
+// 线程池只从本地 NUMA 节点分配内存的调度器名称
+static ConfigVar<std::set<std::string>>::ptr g_scheduler_numa_local =
+    Config::Lookup("scheduler.numa_local", std::set<std::string>{},
+                   "names of schedulers whose workers allocate node-local memory");
 // 当前线程的协程调度器
 static thread_local Scheduler* t_scheduler = nullptr;
 // 协程调度器的调度工作协程
 static thread_local Fiber* t_scheduler_fiber = nullptr;
+// 当前调度线程在调度器 m_workers 中的下标，不是调度线程时为 -1
+static thread_local long t_worker_index = -1;
+// 当前任务本次换入的时间，没有执行任务时为 0
+static thread_local uint64_t t_task_start_ns = 0;
+
+/**
+ * ===================================================
+ * Scheduler::TaskPool 的实现
+ * ===================================================
+*/
+
+/**
+ * @brief 任务节点对象池
+ * 每条线程缓存一组空闲节点，缓存过多时成批归还到全局空闲列表，缓存用完时再从全局空闲列表成批取回，
+ * 只有全局空闲列表也为空时才会申请新的节点
+ * */
+struct Scheduler::TaskPool
+{
+    // 线程缓存的空闲节点数量上限
+    static constexpr size_t MAX_LOCAL_SIZE = 256;
+    // 与全局空闲列表一次交换的节点数量
+    static constexpr size_t BATCH_SIZE = 128;
+
+    // 全局空闲列表
+    struct Global
+    {
+        Mutex mutex;
+        std::vector<Task*> nodes;
+
+        ~Global()
+        {
+            for (auto node : nodes)
+            {
+                delete node;
+            }
+        }
+    };
+
+    // 线程缓存，用任务节点的 next 指针串成单链表
+    struct Local
+    {
+        Task* head = nullptr;
+        size_t size = 0;
+
+        Task* pop()
+        {
+            Task* node = head;
+            head = node->next.load(std::memory_order_relaxed);
+            --size;
+            return node;
+        }
+
+        void push(Task* node)
+        {
+            node->next.store(head, std::memory_order_relaxed);
+            head = node;
+            ++size;
+        }
+
+        // 线程退出时，把缓存的节点归还给全局空闲列表
+        ~Local()
+        {
+            Global& global = GetGlobal();
+            ScopedLock lock(&global.mutex);
+            while (head)
+            {
+                global.nodes.push_back(pop());
+            }
+        }
+    };
+
+    static Global& GetGlobal()
+    {
+        static Global s_global;
+        return s_global;
+    }
+
+    static Local& GetLocal()
+    {
+        static thread_local Local t_local;
+        return t_local;
+    }
+
+    static Task* Acquire()
+    {
+        Local& local = GetLocal();
+        if (!local.head)
+        { // 线程缓存为空，从全局空闲列表取回一批
+            Global& global = GetGlobal();
+            ScopedLock lock(&global.mutex);
+            for (size_t i = 0; i < BATCH_SIZE && !global.nodes.empty(); i++)
+            {
+                local.push(global.nodes.back());
+                global.nodes.pop_back();
+            }
+        }
+        if (!local.head)
+        {
+            return new Task();
+        }
+        return local.pop();
+    }
+
+    static void Release(Task* task)
+    {
+        task->reset();
+        Local& local = GetLocal();
+        local.push(task);
+        if (local.size > MAX_LOCAL_SIZE)
+        { // 线程缓存过多，归还一批给全局空闲列表
+            Global& global = GetGlobal();
+            ScopedLock lock(&global.mutex);
+            for (size_t i = 0; i < BATCH_SIZE; i++)
+            {
+                global.nodes.push_back(local.pop());
+            }
+        }
+    }
+};
+
+Scheduler::Task::uptr Scheduler::Task::Create()
+{
+    return uptr(TaskPool::Acquire());
+}
+
+void Scheduler::Task::Deleter::operator()(Task* task) const
+{
+    TaskPool::Release(task);
+}
+
+/**
+ * ===================================================
+ * Scheduler 统计信息的实现
+ * ===================================================
+*/
+
+// 只有一个线程写入的计数，不需要原子的读-改-写指令
+static inline void AddCounter(std::atomic_uint64_t& counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+}
+
+// 记录一次耗时到直方图
+static inline void RecordLatency(std::atomic_uint64_t* buckets,
+                                 std::atomic_uint64_t& sum, uint64_t ns)
+{
+    AddCounter(buckets[63 - __builtin_clzll(ns | 1)], 1);
+    AddCounter(sum, ns);
+}
+
+// 把各调度线程的直方图累加到 histogram
+static void MergeLatency(Scheduler::LatencyHistogram& histogram,
+                         const std::atomic_uint64_t* buckets,
+                         const std::atomic_uint64_t& sum)
+{
+    for (size_t i = 0; i < Scheduler::LatencyHistogram::BUCKET_COUNT; i++)
+    {
+        uint64_t count = buckets[i].load(std::memory_order_relaxed);
+        histogram.buckets[i] += count;
+        histogram.count += count;
+    }
+    histogram.sum_ns += sum.load(std::memory_order_relaxed);
+}
+
+double Scheduler::LatencyHistogram::mean() const
+{
+    return count ? static_cast<double>(sum_ns) / count : 0;
+}
+
+uint64_t Scheduler::LatencyHistogram::percentile(double p) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(p * count);
+    if (target == 0)
+    {
+        target = 1;
+    }
+    uint64_t accumulated = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++)
+    {
+        accumulated += buckets[i];
+        if (accumulated >= target)
+        {
+            return i + 1 < BUCKET_COUNT ? (1ull << (i + 1)) : UINT64_MAX;
+        }
+    }
+    return UINT64_MAX;
+}
+
+double Scheduler::WorkerStats::utilization() const
+{
+    uint64_t total = busy_ns + idle_ns;
+    return total ? static_cast<double>(busy_ns) / total : 0;
+}
+
+std::string Scheduler::Stats::toString() const
+{
+    std::stringstream ss;
+    ss << "等待任务数=" << queue_length
+       << " (high=" << queue_depth[PRIORITY_HIGH]
+       << " normal=" << queue_depth[PRIORITY_NORMAL]
+       << " low=" << queue_depth[PRIORITY_LOW] << ")"
+       << " 活跃线程=" << active_threads
+       << " 空闲线程=" << idle_threads << "\n";
+    auto histogram = [&ss](const char* name, const LatencyHistogram& h) {
+        ss << name << ": count=" << h.count
+           << " mean=" << static_cast<uint64_t>(h.mean()) << "ns"
+           << " p50<=" << h.percentile(0.5) << "ns"
+           << " p99<=" << h.percentile(0.99) << "ns"
+           << " max<=" << h.percentile(1.0) << "ns\n";
+    };
+    histogram("排队时间", queue_delay);
+    histogram("执行时间", run_time);
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        const WorkerStats& worker = workers[i];
+        ss << "worker[" << i << "] tid=" << worker.thread_id
+           << " tasks=" << worker.tasks
+           << " steals=" << worker.steals
+           << " busy=" << worker.busy_ns / 1000000 << "ms"
+           << " idle=" << worker.idle_ns / 1000000 << "ms"
+           << " overruns=" << worker.overruns
+           << " fiber_reuses=" << worker.fiber_reuses
+           << " 利用率=" << static_cast<int>(worker.utilization() * 100) << "%\n";
+    }
+    return ss.str();
+}
+
+/**
+ * ===================================================
+ * Scheduler 的实现
+ * ===================================================
+*/
 
 Scheduler* Scheduler::GetThis()
 {
@@ -21,8 +287,30 @@ Fiber* Scheduler::GetMainFiber()
     return t_scheduler_fiber;
 }
 
-Scheduler::Scheduler(size_t thread_size, bool use_caller, std::string name)
-    : m_name(std::move(name))
+uint64_t Scheduler::GetTaskRunTime()
+{
+    return t_task_start_ns ? GetCurrentNS() - t_task_start_ns : 0;
+}
+
+void Scheduler::SwitchTo(Scheduler* target, long thread_id)
+{
+    assert(target && "目标调度器不可为空");
+    if (t_scheduler == target && (thread_id == -1 || thread_id == GetThreadID()))
+    {
+        return;
+    }
+    // 调度协程和没有调度器的线程不能被挂起
+    assert(t_scheduler && Fiber::GetFiberID() != 0 && "只能在调度器的任务协程中调用");
+    Fiber::ptr fiber = Fiber::GetThis();
+    assert(fiber.get() != t_scheduler_fiber && "只能在调度器的任务协程中调用");
+    // 目标调度器可能在当前线程换出之前就取到协程，这时协程仍处于 EXEC 状态，会被放回队列稍后执行
+    target->schedule(std::move(fiber), thread_id);
+    Fiber::YieldToHold();
+}
+
+Scheduler::Scheduler(size_t thread_size, bool use_caller, std::string name,
+                     ThreadAffinity affinity)
+    : m_name(std::move(name)), m_affinity(std::move(affinity))
 {
     assert(thread_size > 0);
     if (use_caller)
@@ -47,11 +335,77 @@ Scheduler::Scheduler(size_t thread_size, bool use_caller, std::string name)
         m_root_thread_id = -1;
     }
     m_thread_count = thread_size;
+    // 配置项中指定了线程数量时以配置项为准
+    auto thread_counts = g_scheduler_threads->getValue();
+    auto thread_iter = thread_counts.find(m_name);
+    if (thread_iter != thread_counts.end() && thread_iter->second > 0)
+    {
+        m_thread_count = thread_iter->second - (use_caller ? 1 : 0);
+    }
+    // 每条调度线程一个工作队列，use_caller 为 true 时包括主线程，按线程数量上限预留
+    int max_threads = g_scheduler_max_threads->getValue();
+    size_t pool_capacity = std::max(m_thread_count, static_cast<size_t>(std::max(max_threads, 0)));
+    size_t worker_count = pool_capacity + (use_caller ? 1 : 0);
+    m_workers.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    if (use_caller)
+    {
+        m_workers[0]->state = Worker::ACTIVE;
+        m_workers[0]->thread_id = m_root_thread_id;
+        m_worker_limit = 1;
+    }
+    // 构造时没有指定放置策略，使用配置项
+    if (m_affinity.cpus.empty())
+    {
+        auto cpus = g_scheduler_cpus->getValue();
+        auto iter = cpus.find(m_name);
+        if (iter != cpus.end())
+        {
+            m_affinity.cpus = iter->second;
+        }
+    }
+    if (g_scheduler_numa_local->getValue().count(m_name))
+    {
+        m_affinity.numa_local = true;
+    }
+    // 权重至少为 1，保证每个优先级都能被轮到
+    auto weights = g_scheduler_priority_weights->getValue();
+    for (size_t i = 0; i < PRIORITY_COUNT; i++)
+    {
+        int weight = i < weights.size() ? weights[i] : 1;
+        m_priority_weights[i] = weight > 0 ? static_cast<uint32_t>(weight) : 1;
+        m_total_weight += m_priority_weights[i];
+    }
+    int batch_size = g_scheduler_batch_size->getValue();
+    m_batch_size = batch_size > 1 ? static_cast<size_t>(batch_size) : 1;
+    int fiber_cache_size = g_scheduler_fiber_cache_size->getValue();
+    m_fiber_cache_size = fiber_cache_size > 0 ? static_cast<size_t>(fiber_cache_size) : 0;
+    // 配置项修改后调整线程数量
+    m_config_listener_id = g_scheduler_threads->addListener(
+        [this](const std::map<std::string, int>& old_value,
+               const std::map<std::string, int>& new_value) {
+            auto iter = new_value.find(m_name);
+            if (iter == new_value.end() || iter->second <= 0)
+            {
+                return;
+            }
+            auto old_iter = old_value.find(m_name);
+            if (old_iter == old_value.end() || old_iter->second != iter->second)
+            {
+                setThreadCount(iter->second);
+            }
+        });
 }
 
 Scheduler::~Scheduler()
 {
     LOG_DEBUG(system_logger, "调用 Scheduler::~Scheduler()");
+    // 看门狗不再访问调度线程的状态之后才能释放
+    Watchdog::GetInstance()->del(this);
+    g_scheduler_threads->delListener(m_config_listener_id);
     assert(m_auto_stop);
     if (GetThis() == this)
     {
@@ -69,16 +423,12 @@ void Scheduler::start()
             return;
         }
         m_stopping = false;
-        assert(m_thread_list.empty());
-        m_thread_list.resize(m_thread_count);
         for (size_t i = 0; i < m_thread_count; i++)
         {
-            m_thread_list[i] = std::make_shared<Thread>(
-                std::bind(&Scheduler::run, this),
-                m_name + "_" + std::to_string(i));
-            m_thread_id_list.push_back(m_thread_list[i]->getId());
+            startWorker(poolOffset() + i);
         }
     }
+    Watchdog::GetInstance()->add(this);
     // m_root_fiber 存在就将它换入
     // if (m_root_fiber)
     // {
@@ -87,14 +437,149 @@ void Scheduler::start()
     // }
 }
 
+void Scheduler::startWorker(size_t slot)
+{
+    Worker& worker = *m_workers[slot];
+    assert(worker.state == Worker::FREE);
+    // 之前使用这个位置的线程已经转交完任务，等待它彻底退出
+    if (worker.thread)
+    {
+        worker.thread->join();
+        worker.thread.reset();
+    }
+    // 每条线程绑定 CPU 列表中的一个 CPU，线程数多于 CPU 数时循环分配
+    size_t index = slot - poolOffset();
+    ThreadAffinity affinity;
+    affinity.numa_local = m_affinity.numa_local;
+    if (!m_affinity.cpus.empty())
+    {
+        affinity.cpus.push_back(m_affinity.cpus[index % m_affinity.cpus.size()]);
+    }
+    worker.state = Worker::ACTIVE;
+    worker.thread = std::make_shared<Thread>(
+        [this, slot]() {
+            t_worker_index = static_cast<long>(slot);
+            run();
+        },
+        m_name + "_" + std::to_string(index), std::move(affinity));
+    // 线程创建完成后立即登记线程 id，之后绑定该线程的任务可以直接投递到它的信箱
+    worker.thread_id = worker.thread->getId();
+    if (m_worker_limit < slot + 1)
+    {
+        m_worker_limit = slot + 1;
+    }
+    // 重新生成线程 id 列表
+    m_thread_id_list.clear();
+    for (size_t i = 0; i < m_worker_limit; i++)
+    {
+        long thread_id = m_workers[i]->thread_id;
+        if (thread_id != -1)
+        {
+            m_thread_id_list.push_back(thread_id);
+        }
+    }
+}
+
+void Scheduler::setThreadCount(size_t thread_count)
+{
+    size_t offset = poolOffset();
+    // 至少保留一条调度线程
+    size_t pool_count = thread_count > offset ? thread_count - offset : 0;
+    if (pool_count + offset == 0)
+    {
+        pool_count = 1;
+    }
+    size_t capacity = m_workers.size() - offset;
+    if (pool_count > capacity)
+    {
+        LOG_FMT_WARN(system_logger,
+                     "调度器 %s 的线程数量 %zu 超过上限 %zu",
+                     m_name.c_str(), pool_count, capacity);
+        pool_count = capacity;
+    }
+    ScopedLock lock(&m_mutex);
+    if (m_auto_stop)
+    { // 调度器正在停止
+        return;
+    }
+    if (m_stopping)
+    { // 调度器还没有启动，启动时再创建线程
+        m_thread_count = pool_count;
+        return;
+    }
+    size_t current = m_thread_count;
+    if (pool_count > current)
+    {
+        size_t need = pool_count - current;
+        // 优先撤销还没开始退出的线程的缩容，再使用空闲的位置
+        for (size_t slot = offset; slot < m_workers.size() && need > 0; slot++)
+        {
+            auto expected = Worker::RETIRING;
+            if (m_workers[slot]->state.compare_exchange_strong(expected, Worker::ACTIVE))
+            {
+                --need;
+            }
+        }
+        for (size_t slot = offset; slot < m_workers.size() && need > 0; slot++)
+        {
+            if (m_workers[slot]->state == Worker::FREE)
+            {
+                startWorker(slot);
+                --need;
+            }
+        }
+        pool_count -= need;
+    }
+    else if (pool_count < current)
+    {
+        size_t surplus = current - pool_count;
+        // 从后往前选择要退出的线程
+        for (size_t slot = m_workers.size(); slot > offset && surplus > 0; slot--)
+        {
+            Worker& worker = *m_workers[slot - 1];
+            auto expected = Worker::ACTIVE;
+            if (worker.state.compare_exchange_strong(expected, Worker::RETIRING))
+            {
+                --surplus;
+                // 直接唤醒要退出的线程，让它尽快回到 run() 发现自己的状态；
+                // 线程正在执行任务时唤醒会留到它下一次阻塞等待时生效
+                long thread_id = worker.thread_id;
+                if (thread_id != -1)
+                {
+                    tickleThread(thread_id);
+                }
+            }
+        }
+    }
+    LOG_FMT_INFO(system_logger, "调度器 %s 的线程池线程数量 %zu -> %zu",
+                 m_name.c_str(), current, pool_count);
+    m_thread_count = pool_count;
+}
+
+size_t Scheduler::getThreadCount() const
+{
+    ScopedLock lock(&m_mutex);
+    return m_thread_count + poolOffset();
+}
+
 void Scheduler::stop()
 {
     LOG_DEBUG(system_logger, "调用 Scheduler::stop()");
-    m_auto_stop = true;
+    size_t thread_count = 0;
+    bool has_pool_thread = false;
+    { // !!! 作用域锁，之后不会再调整线程数量
+        ScopedLock lock(&m_mutex);
+        m_auto_stop = true;
+        thread_count = m_thread_count;
+        for (auto& worker : m_workers)
+        {
+            has_pool_thread = has_pool_thread || worker->thread;
+        }
+    }
     // 实例化调度器时的参数 use_caller 为 true, 并且指定线程数量为 1 时
     // 说明只有当前一条主线程在执行，简单等待执行结束即可
     if (m_root_fiber &&
-        m_thread_count == 0 &&
+        !has_pool_thread &&
         (m_root_fiber->finish() || m_root_fiber->getState() == Fiber::INIT))
     {
         m_stopping = true;
@@ -105,7 +590,7 @@ void Scheduler::stop()
     //    assert(m_root_thread_id == -1 && GetThis() != this);
     //    assert(m_root_thread_id != -1 && GetThis() == this);
     m_stopping = true;
-    for (size_t i = 0; i < m_thread_count; i++)
+    for (size_t i = 0; i < thread_count; i++)
     {
         tickle();
     }
@@ -118,12 +603,22 @@ void Scheduler::stop()
         }
     }
 
-    { // join 所有子线程
-        for (auto& t : m_thread_list)
+    { // join 所有子线程，包括已经退出的线程
+        std::vector<Thread::ptr> threads;
+        {
+            ScopedLock lock(&m_mutex);
+            for (auto& worker : m_workers)
+            {
+                if (worker->thread)
+                {
+                    threads.push_back(std::move(worker->thread));
+                }
+            }
+        }
+        for (auto& t : threads)
         {
             t->join();
         }
-        m_thread_list.clear();
     }
     if (onStop())
     {
@@ -134,7 +629,7 @@ void Scheduler::stop()
 bool Scheduler::isStop()
 {
     // 调用过 Scheduler::stop()，并且任务列表没有新任务，也没有正在执行的协程，说明调度器已经彻底停止
-    return m_auto_stop && m_task_list.empty() && m_active_thread_count == 0;
+    return m_auto_stop && m_task_count == 0 && m_active_thread_count == 0;
 }
 
 void Scheduler::tickle()
@@ -142,6 +637,405 @@ void Scheduler::tickle()
     //    LOG_DEBUG(system_logger, "调用 Scheduler::tickle()");
 }
 
+Scheduler::Stats Scheduler::getStats() const
+{
+    Stats stats;
+    stats.queue_length = m_task_count;
+    for (size_t i = 0; i < PRIORITY_COUNT; i++)
+    {
+        stats.queue_depth[i] = m_queue_depth[i];
+    }
+    stats.active_threads = m_active_thread_count;
+    stats.idle_threads = m_idle_thread_count;
+    size_t worker_limit = m_worker_limit;
+    stats.workers.reserve(worker_limit);
+    for (size_t i = 0; i < worker_limit; i++)
+    {
+        auto& worker = m_workers[i];
+        WorkerStats worker_stats;
+        worker_stats.thread_id = worker->thread_id;
+        worker_stats.tasks = worker->tasks.load(std::memory_order_relaxed);
+        worker_stats.steals = worker->steals.load(std::memory_order_relaxed);
+        worker_stats.busy_ns = worker->busy_ns.load(std::memory_order_relaxed);
+        worker_stats.idle_ns = worker->idle_ns.load(std::memory_order_relaxed);
+        worker_stats.overruns = worker->overruns.load(std::memory_order_relaxed);
+        worker_stats.fiber_reuses = worker->fiber_reuses.load(std::memory_order_relaxed);
+        stats.workers.push_back(worker_stats);
+        MergeLatency(stats.queue_delay, worker->queue_delay, worker->queue_delay_sum);
+        MergeLatency(stats.run_time, worker->run_time, worker->run_time_sum);
+    }
+    return stats;
+}
+
+std::string Scheduler::dumpStats() const
+{
+    std::string text = getStats().toString();
+    LOG_FMT_INFO(system_logger, "调度器 %s 统计信息:\n%s", m_name.c_str(), text.c_str());
+    return text;
+}
+
+size_t Scheduler::checkOverruns(uint64_t now_ns, uint64_t threshold_ns)
+{
+    size_t found = 0;
+    size_t worker_limit = m_worker_limit;
+    for (size_t i = 0; i < worker_limit; i++)
+    {
+        Worker& worker = *m_workers[i];
+        uint64_t start_ns = worker.run_start_ns.load(std::memory_order_acquire);
+        // 同一次执行只报告一次
+        if (start_ns == 0 || start_ns == worker.reported_start_ns ||
+            now_ns < start_ns + threshold_ns)
+        {
+            continue;
+        }
+        worker.reported_start_ns = start_ns;
+        AddCounter(worker.overruns, 1);
+        ++found;
+        long thread_id = worker.thread_id;
+        uint64_t fiber_id = worker.run_fiber_id.load(std::memory_order_relaxed);
+        std::string stack = Watchdog::GetInstance()->captureBacktrace(thread_id);
+        // 获取调用栈期间任务可能已经换出，此时调用栈属于之后的任务，不再输出
+        if (worker.run_start_ns.load(std::memory_order_acquire) != start_ns)
+        {
+            stack.clear();
+        }
+        LOG_FMT_WARN(system_logger,
+                     "调度器 %s 的线程 %ld 上的协程 %lu 已经连续执行 %lu ms，没有让出，调用栈:\n%s",
+                     m_name.c_str(), thread_id, fiber_id,
+                     (now_ns - start_ns) / 1000000, stack.empty() ? "(未获取)" : stack.c_str());
+    }
+    return found;
+}
+
+bool Scheduler::hasRunnableTask() const
+{
+    if (t_scheduler == this && t_worker_index != -1 &&
+        m_workers[t_worker_index]->mailbox_size > 0)
+    {
+        return true;
+    }
+    return m_task_count > m_pinned_task_count;
+}
+
+void Scheduler::setSleeping(bool sleeping)
+{
+    if (t_scheduler == this && t_worker_index != -1)
+    {
+        m_workers[t_worker_index]->sleeping = sleeping;
+    }
+}
+
+bool Scheduler::isRetiring() const
+{
+    // 只认 EXITING：RETIRING 还可能被扩容撤销，idle 协程此时返回的话，线程会不经过 retireWorker() 直接退出
+    return t_scheduler == this && t_worker_index != -1 &&
+           m_workers[t_worker_index]->state == Worker::EXITING;
+}
+
+Scheduler::Worker* Scheduler::findWorker(long thread_id) const
+{
+    // 调度线程给自己投递任务是最常见的情况，例如协程换出后重新加入调度
+    if (t_scheduler == this && t_worker_index != -1 &&
+        m_workers[t_worker_index]->thread_id == thread_id)
+    {
+        return m_workers[t_worker_index].get();
+    }
+    size_t worker_limit = m_worker_limit;
+    for (size_t i = 0; i < worker_limit; i++)
+    {
+        if (m_workers[i]->thread_id == thread_id)
+        {
+            return m_workers[i].get();
+        }
+    }
+    return nullptr;
+}
+
+bool Scheduler::enqueue(Task::uptr task)
+{
+    // 先增加计数再放入队列，保证取出任务时计数不会小于 0
+    bool need_tickle = m_task_count++ == 0;
+    ++m_queue_depth[task->priority];
+    task->enqueue_ns = GetCurrentNS();
+    if (task->thread_id != -1)
+    { // 绑定了线程的任务，直接投递到目标线程的信箱
+        Worker* worker = findWorker(task->thread_id);
+        if (worker)
+        {
+            ++m_pinned_task_count;
+            ++worker->mailbox_size;
+            // 先增加信箱计数再确认线程没有退出，与 retireWorker() 中先注销线程 id 再等待信箱清空对应
+            long thread_id = task->thread_id;
+            if (worker->thread_id == thread_id)
+            {
+                worker->mailbox.push(task.release());
+                // 其他空闲线程执行不了这个任务，直接唤醒目标线程
+                if (worker->sleeping)
+                {
+                    tickleThread(thread_id);
+                }
+                return false;
+            }
+            --worker->mailbox_size;
+            --m_pinned_task_count;
+        }
+        LOG_FMT_ERROR(system_logger,
+                      "调度器 %s 中不存在线程 %ld，忽略任务绑定的线程",
+                      m_name.c_str(), task->thread_id);
+        task->thread_id = -1;
+    }
+    if (task->priority == PRIORITY_NORMAL && t_scheduler == this && t_worker_index != -1)
+    { // 调度线程自己产生的普通任务，放入本地队列
+        m_workers[t_worker_index]->queue.push(task.release());
+        return need_tickle;
+    }
+    // 其他线程提交的任务，以及高、低优先级的任务，放入对应优先级的共享队列
+    pushShared(task.release());
+    return need_tickle;
+}
+
+void Scheduler::pushShared(Task* task)
+{
+    SharedQueue& shared = m_shared_queues[task->priority];
+    ++shared.size;
+    shared.queue.push(task);
+}
+
+void Scheduler::requeue(Worker& worker, Task::uptr task)
+{
+    if (task->thread_id != -1)
+    {
+        ++m_pinned_task_count;
+        ++worker.mailbox_size;
+        worker.mailbox.push(task.release());
+    }
+    else if (task->priority == PRIORITY_NORMAL)
+    {
+        worker.queue.push(task.release());
+    }
+    else
+    {
+        pushShared(task.release());
+    }
+}
+
+void Scheduler::retireWorker(Worker& worker)
+{
+    // 先注销线程 id，之后不会再有新任务投递到信箱
+    worker.thread_id = -1;
+    while (Task* task = worker.queue.pop())
+    {
+        pushShared(task);
+    }
+    // 等待正在投递的任务全部到达，再把信箱中的任务转交出去
+    size_t unpinned = 0;
+    while (worker.mailbox_size > 0)
+    {
+        Task* task = worker.mailbox.pop();
+        if (!task)
+        {
+            sched_yield();
+            continue;
+        }
+        --worker.mailbox_size;
+        --m_pinned_task_count;
+        task->thread_id = -1;
+        pushShared(task);
+        ++unpinned;
+    }
+    if (unpinned > 0)
+    {
+        LOG_FMT_WARN(system_logger,
+                     "调度器 %s 的线程 %ld 退出，%zu 个绑定在该线程上的任务改为不绑定线程",
+                     m_name.c_str(), GetThreadID(), unpinned);
+    }
+    worker.state = Worker::FREE;
+    // 转交的任务需要其他线程来执行
+    if (m_task_count > 0)
+    {
+        tickle();
+    }
+}
+
+void Scheduler::enableSimulation(uint64_t seed)
+{
+    assert(m_root_thread_id != -1 && m_thread_count == 0 && m_stopping &&
+           "模拟模式只能用于只有主线程、还没有启动的调度器");
+    m_sim_rng = std::make_unique<std::mt19937_64>(seed);
+}
+
+Scheduler::Task::uptr Scheduler::takeRandomTask(size_t index)
+{
+    Worker& worker = *m_workers[index];
+    // 按固定的顺序取出所有队列中的任务，保证候选列表的顺序只取决于调度操作的顺序
+    while (Task* task = worker.mailbox.pop())
+    {
+        --worker.mailbox_size;
+        --m_pinned_task_count;
+        m_sim_ready.emplace_back(task);
+    }
+    for (size_t i = 0; i < PRIORITY_COUNT; i++)
+    {
+        while (Task::uptr task = takeTask(index, static_cast<Priority>(i)))
+        {
+            m_sim_ready.push_back(std::move(task));
+        }
+    }
+    if (m_sim_ready.empty())
+    {
+        return nullptr;
+    }
+    size_t chosen = (*m_sim_rng)() % m_sim_ready.size();
+    std::swap(m_sim_ready[chosen], m_sim_ready.back());
+    Task::uptr task = std::move(m_sim_ready.back());
+    m_sim_ready.pop_back();
+    return task;
+}
+
+Scheduler::Task::uptr Scheduler::takeTask(size_t index)
+{
+    if (m_sim_rng)
+    {
+        return takeRandomTask(index);
+    }
+    Worker& worker = *m_workers[index];
+    // 先处理绑定在本线程上的任务，这些任务只能由本线程执行
+    Task* task = worker.mailbox.pop();
+    if (task)
+    {
+        --worker.mailbox_size;
+        --m_pinned_task_count;
+        return Task::uptr(task);
+    }
+    // 按权重轮流选择本轮优先查找的优先级
+    uint32_t slot = worker.rounds++ % m_total_weight;
+    size_t first = 0;
+    while (slot >= m_priority_weights[first])
+    {
+        slot -= m_priority_weights[first];
+        ++first;
+    }
+    Task::uptr result = takeTask(index, static_cast<Priority>(first));
+    // 选中的优先级没有任务时，按优先级从高到低查找其他队列，避免线程空转
+    for (size_t i = 0; !result && i < PRIORITY_COUNT; i++)
+    {
+        if (i != first)
+        {
+            result = takeTask(index, static_cast<Priority>(i));
+        }
+    }
+    return result;
+}
+
+Scheduler::Task::uptr Scheduler::takeTask(size_t index, Priority priority)
+{
+    Task* task = nullptr;
+    // 普通任务先从本地队列取
+    if (priority == PRIORITY_NORMAL)
+    {
+        task = m_workers[index]->queue.pop();
+        if (task)
+        {
+            return Task::uptr(task);
+        }
+    }
+    // 再查找共享队列
+    SharedQueue& shared = m_shared_queues[priority];
+    if (shared.size > 0)
+    {
+        size_t taken = 0;
+        { // !!! 作用域锁
+            ScopedLock lock(&shared.mutex);
+            task = shared.queue.pop();
+            if (task)
+            {
+                taken = 1;
+                // 普通任务成批取出，多出的放入本地队列。本地队列可以被窃取，当前线程阻塞在某个任务上时，
+                // 其余任务会被其他线程取走，不会被耽搁。高、低优先级的任务逐个取出，保持优先级顺序
+                if (priority == PRIORITY_NORMAL && m_batch_size > 1)
+                {
+                    // 公平上限：最多取走平均分给每条调度线程的份额，避免一条线程把任务全部取走
+                    size_t limit = std::min(m_batch_size, shared.size / m_worker_limit + 1);
+                    WorkStealingQueue<Task*>& local = m_workers[index]->queue;
+                    while (taken < limit)
+                    {
+                        Task* extra = shared.queue.pop();
+                        if (!extra)
+                        {
+                            break;
+                        }
+                        local.push(extra);
+                        ++taken;
+                    }
+                }
+                shared.size -= taken;
+            }
+        }
+        if (task)
+        {
+            // 本地队列里多了任务，唤醒空闲线程来窃取
+            if (taken > 1)
+            {
+                tickle();
+            }
+            return Task::uptr(task);
+        }
+    }
+    // 最后从其他调度线程的本地队列窃取普通任务
+    if (priority == PRIORITY_NORMAL)
+    {
+        size_t worker_count = m_worker_limit;
+        for (size_t i = 1; i < worker_count && m_task_count > 0; i++)
+        {
+            task = m_workers[(index + i) % worker_count]->queue.steal();
+            if (task)
+            {
+                AddCounter(m_workers[index]->steals, 1);
+                return Task::uptr(task);
+            }
+        }
+    }
+    return nullptr;
+}
+
+void Scheduler::beginRun(Worker& worker, uint64_t fiber_id, uint64_t start_ns)
+{
+    t_task_start_ns = start_ns;
+    worker.run_fiber_id.store(fiber_id, std::memory_order_relaxed);
+    worker.run_start_ns.store(start_ns, std::memory_order_release);
+}
+
+void Scheduler::endRun(Worker& worker, uint64_t start_ns)
+{
+    worker.run_start_ns.store(0, std::memory_order_release);
+    t_task_start_ns = 0;
+    --m_active_thread_count;
+    uint64_t elapsed = GetCurrentNS() - start_ns;
+    RecordLatency(worker.run_time, worker.run_time_sum, elapsed);
+    AddCounter(worker.busy_ns, elapsed);
+    AddCounter(worker.tasks, 1);
+}
+
+void Scheduler::runInline(Task::uptr task)
+{
+    // 调度协程不能挂起，被 hook 的调用退化为阻塞调用
+    bool hook_enabled = isHookEnabled();
+    setHookEnable(false);
+    try
+    {
+        task->callback();
+    }
+    catch (std::exception& e)
+    {
+        LOG_FMT_ERROR(system_logger, "调度器 %s 的内联任务抛出异常: %s", m_name.c_str(), e.what());
+    }
+    catch (...)
+    {
+        LOG_FMT_ERROR(system_logger, "调度器 %s 的内联任务抛出异常", m_name.c_str());
+    }
+    setHookEnable(hook_enabled);
+}
+
 void Scheduler::run()
 {
     LOG_DEBUG(system_logger, "调用 Scheduler::run()");
@@ -152,82 +1046,119 @@ void Scheduler::run()
     { // 当前线程不存在 master fiber, 创建一个
         t_scheduler_fiber = Fiber::GetThis().get();
     }
+    // 主线程使用下标 0 的工作队列，线程池中的线程在启动时已经设置好了下标
+    if (GetThreadID() == m_root_thread_id)
+    {
+        t_worker_index = 0;
+    }
+    assert(t_worker_index >= 0 && static_cast<size_t>(t_worker_index) < m_workers.size());
+    const size_t worker_index = t_worker_index;
+    Worker& worker = *m_workers[worker_index];
+    worker.thread_id = GetThreadID();
     // 线程空闲时执行的协程
     auto idle_fiber = std::make_shared<Fiber>(
         std::bind(&Scheduler::onIdle, this));
     // 开始调度
-    Task task;
+    Task::uptr task;
     while (true)
     {
-        task.reset();
-        bool tickle_me = false;
+        // 线程池缩容，当前线程需要退出。先结束 idle 协程，再转交剩余的任务
+        auto retiring = Worker::RETIRING;
+        if (worker.state.load(std::memory_order_relaxed) == Worker::RETIRING &&
+            worker.state.compare_exchange_strong(retiring, Worker::EXITING))
+        {
+            if (!idle_fiber->finish())
+            {
+                idle_fiber->swapIn();
+            }
+            retireWorker(worker);
+            break;
+        }
         // 查找等待调度的 task
-        { // !!! 作用域锁
-            ScopedLock lock(&m_mutex);
-            auto iter = m_task_list.begin();
-            while (iter != m_task_list.end())
+        task = takeTask(worker_index);
+        Fiber::ptr fiber;
+        long thread_id = -1;
+        Priority priority = PRIORITY_NORMAL;
+        uint64_t start_ns = 0;
+        bool from_callback = false;
+        if (task)
+        {
+            // 拿到的协程可能还没在原线程上换出，或者它的共享栈正被其他协程使用，放回队列稍后再处理
+            if (task->fiber &&
+                (task->fiber->getState() == Fiber::EXEC || !task->fiber->tryAcquireStack()))
             {
-                // 任务指定了要在那条线程执行，但当前线程不是指定线程，
-                // 通知其他线程处理
-                if ((*iter)->thread_id != -1 && (*iter)->thread_id != GetThreadID())
+                requeue(worker, std::move(task));
+                continue;
+            }
+            ++m_active_thread_count;
+            --m_task_count;
+            --m_queue_depth[task->priority];
+            start_ns = GetCurrentNS();
+            RecordLatency(worker.queue_delay, worker.queue_delay_sum,
+                          start_ns - task->enqueue_ns);
+            thread_id = task->thread_id;
+            priority = task->priority;
+            if (task->inline_run)
+            { // 保证不会让出的回调，不需要协程
+                beginRun(worker, 0, start_ns);
+                runInline(std::move(task));
+                endRun(worker, start_ns);
+                continue;
+            }
+            if (task->callback)
+            { // 如果是 callback 任务，为其创建 fiber，有缓存的协程时直接复用
+                // 回调函数留在任务节点里原地执行，不拷贝，节点在回调执行结束后归还给对象池
+                Task* node = task.release();
+                auto callback = [node]() {
+                    Task::uptr guard(node);
+                    node->callback();
+                };
+                if (!worker.fiber_cache.empty())
                 {
-                    ++iter;
-                    tickle_me = true;
-                    continue;
+                    fiber = std::move(worker.fiber_cache.back());
+                    worker.fiber_cache.pop_back();
+                    fiber->reset(std::move(callback));
+                    AddCounter(worker.fiber_reuses, 1);
                 }
-                assert((*iter)->fiber || (*iter)->callback);
-                // 任务是 fiber，但是是正在执行的，不进行处理
-                if ((*iter)->fiber && (*iter)->fiber->getState() == Fiber::EXEC)
+                else
                 {
-                    ++iter;
-                    continue;
+                    fiber = std::make_shared<Fiber>(std::move(callback));
                 }
-                // 找到可以执行的任务，拷贝一份
-                task = **iter;
-                ++m_active_thread_count;
-                // 从任务列表里移除该任务
-                m_task_list.erase(iter);
-                break;
-            }
-        }
-        if (tickle_me)
-        {
-            tickle();
-        }
-        if (task.callback)
-        { // 如果是 callback 任务，为其创建 fiber
-            task.fiber = std::make_shared<Fiber>(std::move(task.callback));
-            task.callback = nullptr;
-        }
-        if (task.fiber && !task.fiber->finish())
-        { // 是 fiber 任务
-            if (GetThreadID() == m_root_thread_id)
-            {
-                // m_root_thread_id 等于当前线程 id，说明构造调度器时 use_caller 为 true
-                // 使用 m_root_fiber 作为 master fiber
-                // task.fiber->swapIn(m_root_fiber);
-                task.fiber->swapIn();
+                from_callback = true;
             }
             else
             {
-                task.fiber->swapIn();
+                fiber = std::move(task->fiber);
+                task.reset();
             }
-            --m_active_thread_count;
+        }
+        if (fiber && !fiber->finish())
+        { // 是 fiber 任务
+            beginRun(worker, fiber->getID(), start_ns);
+            fiber->swapIn();
+            endRun(worker, start_ns);
             // 协程换出后，继续将其添加到任务队列
-            Fiber::State fiber_status = task.fiber->getState();
+            Fiber::State fiber_status = fiber->getState();
             if (fiber_status == Fiber::READY)
             {
-                schedule(std::move(task.fiber), task.thread_id);
+                schedule(std::move(fiber), thread_id, priority);
             }
             else if (fiber_status != Fiber::EXCEPTION && fiber_status != Fiber::TERM)
             {
-                task.fiber->m_state = Fiber::HOLD;
+                fiber->m_state = Fiber::HOLD;
+            }
+            // 调度器自己创建的协程执行结束且没有其他持有者时，留给下一个回调任务
+            if (from_callback && fiber_status == Fiber::TERM && fiber.use_count() == 1 &&
+                worker.fiber_cache.size() < m_fiber_cache_size)
+            {
+                worker.fiber_cache.push_back(std::move(fiber));
             }
-            // else //if (fiber_status == Fiber::HOLD)
-            // {
-            //     // schedule(std::move(task.fiber));
-            // }
-            task.reset();
+            fiber.reset();
+        }
+        else if (fiber)
+        { // 协程已经执行结束，丢弃该任务
+            --m_active_thread_count;
+            fiber.reset();
         }
         else
         { // 任务队列空了，执行 idle_fiber
@@ -236,17 +1167,9 @@ void Scheduler::run()
                 break;
             }
             ++m_idle_thread_count;
-            // if (GetThreadID() == m_root_thread_id)
-            // {
-            //     // m_root_thread_id 等于当前线程 id，说明构造调度器时 use_caller 为 true
-            //     // 使用 m_root_fiber 作为 master fiber
-            //     idle_fiber->swapIn(m_root_fiber);
-            // }
-            // else if (m_root_thread_id == -1)
-            // {
-            //     idle_fiber->swapIn();
-            // }
+            uint64_t idle_start = GetCurrentNS();
             idle_fiber->swapIn();
+            AddCounter(worker.idle_ns, GetCurrentNS() - idle_start);
             --m_idle_thread_count;
             if (idle_fiber->getState() != Fiber::TERM && 
                 idle_fiber->getState() != Fiber::EXCEPTION)
@@ -255,6 +1178,9 @@ void Scheduler::run()
             }
         }
     }
+    // 在当前线程上释放缓存的协程，协程栈回到当前线程的空闲链表
+    worker.fiber_cache.clear();
+    t_worker_index = -1;
     LOG_DEBUG(system_logger, "Scheduler::run() 结束");
 }
 
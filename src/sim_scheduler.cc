@@ -0,0 +1,134 @@
+#include "sim_scheduler.h"
+#include "log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace zjl
+{
+
+static Logger::ptr system_logger = GET_LOGGER("system");
+
+/**
+ * =========================================
+ * SimScheduler 类的实现
+ * =========================================
+*/
+
+SimScheduler::SimScheduler(uint64_t seed, std::string name, uint64_t start_ms)
+    : Scheduler(1, true, std::move(name)),
+      m_seed(seed),
+      m_now_ms(start_ms)
+{
+    enableSimulation(seed);
+    start();
+}
+
+SimScheduler::~SimScheduler()
+{
+    // 已经 stop() 过时，剩下的协程不会再被唤醒，不能再执行调度协程
+    if (!m_auto_stop)
+    {
+        stop();
+    }
+}
+
+SimScheduler* SimScheduler::GetThis()
+{
+    return dynamic_cast<SimScheduler*>(Scheduler::GetThis());
+}
+
+bool SimScheduler::isStop()
+{
+    return Scheduler::isStop() && !hasTimer();
+}
+
+void SimScheduler::onIdle()
+{
+    while (!isStop())
+    {
+        if (!hasRunnableTask())
+        {
+            uint64_t next = getNextTimer();
+            if (next == ~0ull)
+            {
+                LOG_FMT_INFO(system_logger,
+                             "模拟调度器 %s 在虚拟时间 %lu ms 没有可以执行的任务，剩下的协程不会再被唤醒",
+                             m_name.c_str(), m_now_ms);
+                break;
+            }
+            // 没有任务可以执行时，直接把虚拟时钟拨到下一个定时器的执行时间
+            m_now_ms += next;
+            std::vector<std::function<void()>> callbacks;
+            listExpiredCallback(callbacks);
+            schedule(callbacks.begin(), callbacks.end());
+        }
+        Fiber::YieldToHold();
+    }
+}
+
+/**
+ * =========================================
+ * LoopbackSocket 类的实现
+ * =========================================
+*/
+
+std::pair<LoopbackSocket::ptr, LoopbackSocket::ptr> LoopbackSocket::CreatePair()
+{
+    auto a_to_b = std::make_shared<Pipe>();
+    auto b_to_a = std::make_shared<Pipe>();
+    ptr a(new LoopbackSocket(b_to_a, a_to_b));
+    ptr b(new LoopbackSocket(a_to_b, b_to_a));
+    return {a, b};
+}
+
+LoopbackSocket::~LoopbackSocket()
+{
+    close();
+}
+
+ssize_t LoopbackSocket::read(void* buffer, size_t length)
+{
+    FiberScopedLock lock(&m_in->mutex);
+    m_in->readable.wait(m_in->mutex, [this]() {
+        return !m_in->data.empty() || m_in->writer_closed;
+    });
+    size_t n = std::min(length, m_in->data.size());
+    std::copy_n(m_in->data.begin(), n, static_cast<char*>(buffer));
+    m_in->data.erase(m_in->data.begin(), m_in->data.begin() + n);
+    return static_cast<ssize_t>(n);
+}
+
+ssize_t LoopbackSocket::write(const void* buffer, size_t length)
+{
+    {
+        FiberScopedLock lock(&m_out->mutex);
+        if (m_out->reader_closed || m_out->writer_closed)
+        {
+            errno = EPIPE;
+            return -1;
+        }
+        const char* data = static_cast<const char*>(buffer);
+        m_out->data.insert(m_out->data.end(), data, data + length);
+    }
+    m_out->readable.notifyAll();
+    return static_cast<ssize_t>(length);
+}
+
+void LoopbackSocket::close()
+{
+    if (m_closed)
+    {
+        return;
+    }
+    m_closed = true;
+    {
+        FiberScopedLock lock(&m_out->mutex);
+        m_out->writer_closed = true;
+    }
+    m_out->readable.notifyAll();
+    FiberScopedLock lock(&m_in->mutex);
+    m_in->reader_closed = true;
+}
+
+} // namespace zjl
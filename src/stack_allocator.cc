@@ -0,0 +1,340 @@
+#include "stack_allocator.h"
+#include "config.h"
+#include "exception.h"
+#include "log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace zjl
+{
+
+static Logger::ptr system_logger = GET_LOGGER("system");
+
+// 协程栈分配器，malloc 或 mmap
+static ConfigVar<std::string>::ptr g_fiber_stack_allocator =
+    Config::Lookup<std::string>("fiber.stack_allocator", "mmap", "fiber stack allocator: malloc or mmap");
+// mmap 栈池每个线程缓存的栈数量上限
+static ConfigVar<uint64_t>::ptr g_fiber_stack_cache_per_thread =
+    Config::Lookup<uint64_t>("fiber.stack_cache_per_thread", 16, "stacks cached per thread by the mmap allocator");
+// mmap 栈池全局缓存的栈数量上限
+static ConfigVar<uint64_t>::ptr g_fiber_stack_cache_global =
+    Config::Lookup<uint64_t>("fiber.stack_cache_global", 256, "stacks cached globally by the mmap allocator");
+// 每条线程的共享栈数量
+static ConfigVar<uint64_t>::ptr g_fiber_shared_stack_count =
+    Config::Lookup<uint64_t>("fiber.shared_stack_count", 4, "shared stacks per thread");
+// 共享栈大小
+static ConfigVar<uint64_t>::ptr g_fiber_shared_stack_size =
+    Config::Lookup<uint64_t>("fiber.shared_stack_size", 8 * 1024 * 1024, "size of each shared stack");
+
+// 配置项的缓存，每次创建和销毁协程都要读取
+static std::atomic<StackAllocator*> s_default_allocator{nullptr};
+static std::atomic_uint64_t s_local_limit{0};
+static std::atomic_uint64_t s_global_limit{0};
+
+struct _StackAllocatorIniter
+{
+    _StackAllocatorIniter()
+    {
+        setAllocator(g_fiber_stack_allocator->getValue());
+        g_fiber_stack_allocator->addListener([](const std::string& /*old_value*/, const std::string& new_value) {
+            setAllocator(new_value);
+        });
+        s_local_limit = g_fiber_stack_cache_per_thread->getValue();
+        g_fiber_stack_cache_per_thread->addListener([](const uint64_t& /*old_value*/, const uint64_t& new_value) {
+            s_local_limit = new_value;
+        });
+        s_global_limit = g_fiber_stack_cache_global->getValue();
+        g_fiber_stack_cache_global->addListener([](const uint64_t& /*old_value*/, const uint64_t& new_value) {
+            s_global_limit = new_value;
+        });
+    }
+
+    static void setAllocator(const std::string& name)
+    {
+        StackAllocator* allocator = StackAllocator::Get(name);
+        if (allocator == nullptr)
+        {
+            LOG_FMT_ERROR(system_logger, "未知的协程栈分配器 %s，可选 malloc 或 mmap", name.c_str());
+            allocator = s_default_allocator.load() ? s_default_allocator.load() : MmapStackAllocator::GetInstance();
+        }
+        s_default_allocator = allocator;
+    }
+};
+static _StackAllocatorIniter s_stack_allocator_initer;
+
+// 当前线程的空闲链表是否已经析构
+static thread_local bool t_local_cache_destroyed = false;
+
+/**
+ * =========================================
+ * StackAllocator 类的实现
+ * =========================================
+*/
+
+StackAllocator* StackAllocator::GetDefault()
+{
+    StackAllocator* allocator = s_default_allocator.load(std::memory_order_relaxed);
+    // 其他编译单元的静态初始化中创建协程时，配置项还没有读取
+    return allocator ? allocator : MmapStackAllocator::GetInstance();
+}
+
+StackAllocator* StackAllocator::Get(const std::string& name)
+{
+    if (name == "malloc")
+    {
+        return MallocStackAllocator::GetInstance();
+    }
+    if (name == "mmap")
+    {
+        return MmapStackAllocator::GetInstance();
+    }
+    return nullptr;
+}
+
+/**
+ * =========================================
+ * MallocStackAllocator 类的实现
+ * =========================================
+*/
+
+void* MallocStackAllocator::alloc(size_t size)
+{
+    return ::malloc(size);
+}
+
+void MallocStackAllocator::dealloc(void* stack, size_t /*size*/)
+{
+    ::free(stack);
+}
+
+MallocStackAllocator* MallocStackAllocator::GetInstance()
+{
+    static MallocStackAllocator s_instance;
+    return &s_instance;
+}
+
+/**
+ * =========================================
+ * MmapStackAllocator 类的实现
+ * =========================================
+*/
+
+// 把栈大小向上取整到页大小的整数倍
+static size_t RoundToPage(size_t size)
+{
+    size_t page = MmapStackAllocator::GuardSize();
+    return (size + page - 1) / page * page;
+}
+
+MmapStackAllocator::LocalCache::~LocalCache()
+{
+    t_local_cache_destroyed = true;
+    std::vector<std::pair<void*, size_t>> stacks;
+    for (auto& item : this->stacks)
+    {
+        for (void* stack : item.second)
+        {
+            stacks.emplace_back(stack, item.first);
+        }
+    }
+    MmapStackAllocator::GetInstance()->pushGlobal(stacks);
+}
+
+MmapStackAllocator::LocalCache* MmapStackAllocator::GetLocalCache()
+{
+    if (t_local_cache_destroyed)
+    {
+        return nullptr;
+    }
+    static thread_local LocalCache t_cache;
+    return &t_cache;
+}
+
+void* MmapStackAllocator::alloc(size_t size)
+{
+    size = RoundToPage(size);
+    LocalCache* cache = GetLocalCache();
+    if (cache)
+    {
+        auto it = cache->stacks.find(size);
+        if (it != cache->stacks.end() && !it->second.empty())
+        {
+            void* stack = it->second.back();
+            it->second.pop_back();
+            --cache->count;
+            ++m_local_hits;
+            return stack;
+        }
+    }
+    {
+        ScopedLock lock(&m_mutex);
+        auto it = m_global.find(size);
+        if (it != m_global.end() && !it->second.empty())
+        {
+            void* stack = it->second.back();
+            it->second.pop_back();
+            --m_global_count;
+            ++m_global_hits;
+            return stack;
+        }
+    }
+    return map(size);
+}
+
+void MmapStackAllocator::dealloc(void* stack, size_t size)
+{
+    size = RoundToPage(size);
+    LocalCache* cache = GetLocalCache();
+    if (cache == nullptr)
+    {
+        pushGlobal({{stack, size}});
+        return;
+    }
+    cache->stacks[size].push_back(stack);
+    ++cache->count;
+    uint64_t limit = s_local_limit.load(std::memory_order_relaxed);
+    if (cache->count <= limit)
+    {
+        return;
+    }
+    // 超过上限时一次移走一半，避免在上限附近反复加锁
+    std::vector<std::pair<void*, size_t>> stacks;
+    for (auto& item : cache->stacks)
+    {
+        while (!item.second.empty() && cache->count > limit / 2)
+        {
+            stacks.emplace_back(item.second.back(), item.first);
+            item.second.pop_back();
+            --cache->count;
+        }
+    }
+    pushGlobal(stacks);
+}
+
+void MmapStackAllocator::pushGlobal(const std::vector<std::pair<void*, size_t>>& stacks)
+{
+    std::vector<std::pair<void*, size_t>> overflow;
+    {
+        uint64_t limit = s_global_limit.load(std::memory_order_relaxed);
+        ScopedLock lock(&m_mutex);
+        for (auto& item : stacks)
+        {
+            if (m_global_count < limit)
+            {
+                m_global[item.second].push_back(item.first);
+                ++m_global_count;
+            }
+            else
+            {
+                overflow.push_back(item);
+            }
+        }
+    }
+    for (auto& item : overflow)
+    {
+        unmap(item.first, item.second);
+    }
+}
+
+void* MmapStackAllocator::map(size_t size)
+{
+    size_t guard = GuardSize();
+    void* base = ::mmap(nullptr, size + guard, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        throw Exception(std::string(::strerror(errno)));
+    }
+    // 栈向低地址增长，保护页放在最低地址
+    if (::mprotect(base, guard, PROT_NONE))
+    {
+        int error = errno;
+        ::munmap(base, size + guard);
+        throw Exception(std::string(::strerror(error)));
+    }
+    ++m_mapped;
+    return static_cast<char*>(base) + guard;
+}
+
+void MmapStackAllocator::unmap(void* stack, size_t size)
+{
+    size_t guard = GuardSize();
+    ::munmap(static_cast<char*>(stack) - guard, size + guard);
+    --m_mapped;
+}
+
+MmapStackAllocator::Stats MmapStackAllocator::getStats() const
+{
+    Stats stats;
+    stats.mapped = m_mapped;
+    stats.local_hits = m_local_hits;
+    stats.global_hits = m_global_hits;
+    ScopedLock lock(&m_mutex);
+    stats.global_cached = m_global_count;
+    return stats;
+}
+
+size_t MmapStackAllocator::GuardSize()
+{
+    static const size_t s_page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return s_page_size;
+}
+
+MmapStackAllocator* MmapStackAllocator::GetInstance()
+{
+    // 不析构：进程退出时其他线程仍可能把缓存的栈还给全局空闲链表
+    static MmapStackAllocator* s_instance = new MmapStackAllocator();
+    return s_instance;
+}
+
+/**
+ * =========================================
+ * SharedStack 类的实现
+ * =========================================
+*/
+
+SharedStack::SharedStack(size_t size)
+    : m_bottom(static_cast<char*>(MmapStackAllocator::GetInstance()->alloc(size))),
+      m_size(size)
+{
+}
+
+SharedStack::~SharedStack()
+{
+    MmapStackAllocator::GetInstance()->dealloc(m_bottom, m_size);
+}
+
+bool SharedStack::tryLock(const Fiber* fiber)
+{
+    const Fiber* expected = nullptr;
+    return m_owner.compare_exchange_strong(expected, fiber, std::memory_order_acquire) ||
+           expected == fiber;
+}
+
+void SharedStack::unlock()
+{
+    m_owner.store(nullptr, std::memory_order_release);
+}
+
+SharedStack::ptr SharedStack::Next()
+{
+    // 线程退出后，绑定在这些栈上的协程仍然持有它们
+    static thread_local std::vector<ptr> t_stacks;
+    static thread_local size_t t_next = 0;
+    if (t_stacks.empty())
+    {
+        size_t count = std::max<uint64_t>(g_fiber_shared_stack_count->getValue(), 1);
+        size_t size = g_fiber_shared_stack_size->getValue();
+        for (size_t i = 0; i < count; i++)
+        {
+            t_stacks.push_back(std::make_shared<SharedStack>(size));
+        }
+    }
+    return t_stacks[t_next++ % t_stacks.size()];
+}
+
+} // namespace zjl
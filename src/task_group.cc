@@ -0,0 +1,192 @@
+#include "task_group.h"
+#include "io_manager.h"
+#include "scheduler.h"
+#include "util.h"
+#include <cassert>
+
+namespace zjl
+{
+
+/**
+ * =========================================
+ * CancelToken 类的实现
+ * =========================================
+*/
+
+void CancelToken::cancel(int reason)
+{
+    int expected = 0;
+    if (!m_reason.compare_exchange_strong(expected, reason, std::memory_order_acq_rel))
+    {
+        return;
+    }
+    ScopedLock lock(&m_mutex);
+    for (auto& item : m_callbacks)
+    {
+        item.second();
+    }
+    m_callbacks.clear();
+}
+
+uint64_t CancelToken::addCallback(std::function<void()> callback)
+{
+    {
+        ScopedLock lock(&m_mutex);
+        // 在锁内检查，cancel() 执行回调时也持有锁，不会漏掉
+        if (!isCancelled())
+        {
+            uint64_t id = m_next_id++;
+            m_callbacks.emplace(id, std::move(callback));
+            return id;
+        }
+    }
+    callback();
+    return 0;
+}
+
+void CancelToken::removeCallback(uint64_t id)
+{
+    if (id == 0)
+    {
+        return;
+    }
+    ScopedLock lock(&m_mutex);
+    m_callbacks.erase(id);
+}
+
+const CancelToken::ptr& CancelToken::GetThis()
+{
+    static const ptr s_null;
+    // 没有协程时不创建 master fiber
+    if (Fiber::GetFiberID() == 0)
+    {
+        return s_null;
+    }
+    return Fiber::GetThis()->getCancelToken();
+}
+
+/**
+ * =========================================
+ * TaskGroup 类的实现
+ * =========================================
+*/
+
+TaskGroup::TaskGroup(Scheduler* scheduler)
+    : m_scheduler(scheduler ? scheduler : Scheduler::GetThis()),
+      m_token(std::make_shared<CancelToken>()),
+      m_parent(CancelToken::GetThis())
+{
+    assert(m_scheduler && "TaskGroup 需要指定调度器");
+    if (Fiber::GetFiberID() != 0)
+    {
+        m_deadline = Fiber::GetThis()->getDeadline();
+    }
+    if (m_parent)
+    {
+        std::weak_ptr<CancelToken> weak_token(m_token);
+        m_parent_callback = m_parent->addCallback([weak_token, this]() {
+            if (auto token = weak_token.lock())
+            {
+                token->cancel(m_parent->reason());
+            }
+        });
+    }
+}
+
+TaskGroup::TaskGroup(IOManager* iom, uint64_t timeout_ms)
+    : TaskGroup(static_cast<Scheduler*>(iom))
+{
+    uint64_t deadline = GetCurrentMS() + timeout_ms;
+    if (m_deadline == 0 || deadline < m_deadline)
+    {
+        m_deadline = deadline;
+    }
+    std::weak_ptr<CancelToken> weak_token(m_token);
+    m_deadline_timer = iom->addTimer(timeout_ms, [weak_token]() {
+        if (auto token = weak_token.lock())
+        {
+            token->cancel(ETIMEDOUT);
+        }
+    });
+}
+
+TaskGroup::~TaskGroup()
+{
+    m_wait_group.wait();
+    if (m_deadline_timer)
+    {
+        m_deadline_timer->cancel();
+    }
+    if (m_parent)
+    {
+        m_parent->removeCallback(m_parent_callback);
+    }
+}
+
+void TaskGroup::spawn(std::function<void()> fn)
+{
+    m_wait_group.add();
+    m_scheduler->schedule([this, fn = std::move(fn)]() mutable {
+        {
+            auto fiber = Fiber::GetThis();
+            fiber->setCancelToken(m_token);
+            fiber->setDeadline(m_deadline);
+            // 任务组已经取消，不再执行
+            if (!m_token->isCancelled())
+            {
+                try
+                {
+                    fn();
+                }
+                catch (...)
+                {
+                    fail(std::current_exception());
+                }
+            }
+            fiber->setCancelToken(nullptr);
+            fiber->setDeadline(0);
+            // 子任务捕获的资源在通知任务组之前释放
+            fn = nullptr;
+        }
+        // 之后任务组可能已经被销毁，不能再访问 this
+        m_wait_group.done();
+    });
+}
+
+bool TaskGroup::wait()
+{
+    m_wait_group.wait();
+    if (m_deadline_timer)
+    {
+        m_deadline_timer->cancel();
+        // 子任务按继承的截止时间超时返回时，定时器可能还没来得及触发
+        if (GetCurrentMS() >= m_deadline)
+        {
+            m_token->cancel(ETIMEDOUT);
+        }
+    }
+    {
+        ScopedLock lock(&m_mutex);
+        if (m_exception)
+        {
+            std::rethrow_exception(m_exception);
+        }
+    }
+    return !m_token->isCancelled();
+}
+
+void TaskGroup::fail(std::exception_ptr exception)
+{
+    {
+        ScopedLock lock(&m_mutex);
+        // 任务组取消之后子任务的失败大多是取消导致的，只记录取消之前的第一个异常
+        if (m_exception || m_token->isCancelled())
+        {
+            return;
+        }
+        m_exception = std::move(exception);
+    }
+    m_token->cancel();
+}
+
+} // namespace zjl
@@ -2,6 +2,9 @@
 #include "log.h"
 #include <assert.h>
 #include <exception>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 namespace zjl
@@ -73,15 +76,18 @@ struct ThreadData
     typedef Thread::ThreadFunc ThreadFunc;
     ThreadFunc m_callback;
     std::string m_name;
+    ThreadAffinity m_affinity;
     pid_t* m_id;
     Semaphore* m_semaphore;
 
     ThreadData(ThreadFunc func,
                const std::string& name,
+               ThreadAffinity affinity,
                pid_t* tid,
                Semaphore* sem)
         : m_callback(std::move(func)),
           m_name(name),
+          m_affinity(std::move(affinity)),
           m_id(tid),
           m_semaphore(sem) {}
 
@@ -96,6 +102,8 @@ struct ThreadData
         t_tid = GetThreadID();
         t_thread_name = m_name.empty() ? "UNKNOWN" : m_name;
         pthread_setname_np(pthread_self(), m_name.substr(0, 15).c_str());
+        // 先绑定 CPU，之后线程申请的内存才会落在对应的 NUMA 节点上
+        Thread::SetThisAffinity(m_affinity);
         try
         {
             m_callback();
@@ -134,7 +142,46 @@ void Thread::SetThisThreadName(const std::string& name)
     t_thread_name = name;
 }
 
-Thread::Thread(ThreadFunc callback, const std::string& name)
+bool Thread::SetThisAffinity(const ThreadAffinity& affinity)
+{
+    bool result = true;
+    if (!affinity.cpus.empty())
+    {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for (int cpu : affinity.cpus)
+        {
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+            {
+                CPU_SET(cpu, &cpu_set);
+            }
+        }
+        int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+        if (error)
+        {
+            LOG_FMT_ERROR(
+                system_logger,
+                "pthread_setaffinity_np() 设置 CPU 亲和性失败, 线程名 = %s, 错误码 = %d",
+                t_thread_name.c_str(), error);
+            result = false;
+        }
+    }
+    if (affinity.numa_local)
+    {
+        // 不依赖 libnuma，直接通过系统调用设置内存策略
+        if (syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0) == -1)
+        {
+            LOG_FMT_ERROR(
+                system_logger,
+                "set_mempolicy() 设置内存策略失败, 线程名 = %s, errno = %d",
+                t_thread_name.c_str(), errno);
+            result = false;
+        }
+    }
+    return result;
+}
+
+Thread::Thread(ThreadFunc callback, const std::string& name, ThreadAffinity affinity)
     : m_id(-1),
       m_name(name),
       m_thread(0),
@@ -145,7 +192,7 @@ Thread::Thread(ThreadFunc callback, const std::string& name)
 {
     // 调用 pthread_create 创建新线程
     ThreadData* data =
-        new ThreadData(m_callback, m_name, &m_id, &m_semaphore);
+        new ThreadData(m_callback, m_name, std::move(affinity), &m_id, &m_semaphore);
     int result = pthread_create(&m_thread, nullptr, &Thread::Run, data);
     if (result)
     {
@@ -22,7 +22,11 @@ bool Timer::Comparator::operator()(
     {
         return false;
     }
-    // 时间戳相同就按指针排序
+    // 时间戳相同就按创建顺序排序，不依赖内存地址，相同的操作序列得到相同的执行顺序
+    if (lhs->m_seq != rhs->m_seq)
+    {
+        return lhs->m_seq < rhs->m_seq;
+    }
     return lhs.get() < rhs.get();
 }
 
@@ -33,7 +37,8 @@ Timer::Timer(
       m_fn(fn),
       m_manager(manager)
 {
-    m_next = GetCurrentMS() + m_ms;
+    m_seq = ++manager->m_timer_seq;
+    m_next = manager->nowMS() + m_ms;
 }
 
 Timer::Timer(uint64_t next) : m_next(next)
@@ -73,7 +78,7 @@ bool Timer::reset(uint64_t ms, bool from_now)
     // 重新计时
     if (from_now)
     {
-        start = GetCurrentMS();
+        start = m_manager->nowMS();
     }
     else 
     {
@@ -99,14 +104,15 @@ bool Timer::refresh()
         return false;
     }
     m_manager->m_timers.erase(it);
-    m_next = GetCurrentMS() + m_ms;
+    m_next = m_manager->nowMS() + m_ms;
     m_manager->m_timers.insert(shared_from_this());
     return true;
 }
 
 TimerManager::TimerManager()
 {
-    m_previous_time = GetCurrentMS();
+    // 构造时还不能调用派生类的 nowMS()，第一次检查超时的时候再记录
+    m_previous_time = 0;
 }
 
 TimerManager::~TimerManager()
@@ -158,7 +164,7 @@ uint64_t TimerManager::getNextTimer()
         return ~0ull;
     }
     const Timer::ptr& next = *m_timers.begin();
-    uint64_t now_ms = GetCurrentMS();
+    uint64_t now_ms = nowMS();
     if (now_ms >= next->m_next)
     {
         // 等待超时
@@ -173,7 +179,7 @@ uint64_t TimerManager::getNextTimer()
 
 void TimerManager::listExpiredCallback(std::vector<std::function<void()>>& fns)
 {
-    uint64_t now_ms = GetCurrentMS();
+    uint64_t now_ms = nowMS();
     std::vector<Timer::ptr> expired;
     {
         ReadScopedLock lock(&m_lock);
@@ -226,6 +232,11 @@ bool TimerManager::hasTimer()
     return !m_timers.empty();
 }
 
+uint64_t TimerManager::nowMS() const
+{
+    return GetCurrentMS();
+}
+
 bool TimerManager::detectClockRollover(uint64_t now_ms)
 {
     bool rollover = false;
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <cxxabi.h>
 #include <sys/time.h>
+#include <time.h>
 
 namespace zjl
 {
@@ -100,4 +101,11 @@ uint64_t GetCurrentUS()
     return tv.tv_sec * 1000ul * 1000ul + tv.tv_usec;
 }
 
+uint64_t GetCurrentNS()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000ul * 1000ul * 1000ul + ts.tv_nsec;
+}
+
 } // namespace zjl
@@ -0,0 +1,170 @@
+#include "watchdog.h"
+#include "config.h"
+#include "log.h"
+#include "scheduler.h"
+#include "util.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <execinfo.h>
+#include <sched.h>
+#include <sstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace zjl
+{
+
+static Logger::ptr system_logger = GET_LOGGER("system");
+// 采样间隔，为 0 时关闭看门狗
+static ConfigVar<int>::ptr g_watchdog_interval_ms =
+    Config::Lookup("watchdog.interval_ms", 100, "watchdog sampling interval, 0 to disable");
+// 任务连续执行超过该时间时记为一次超时
+static ConfigVar<int>::ptr g_watchdog_threshold_ms =
+    Config::Lookup("watchdog.threshold_ms", 500, "run time of a task before it is reported");
+
+// 调用栈的最大层数
+static constexpr int MAX_TRACE_DEPTH = 64;
+// 正在请求调用栈的线程 id，信号处理函数取走后清零
+static std::atomic_long s_trace_target{0};
+static std::atomic_bool s_trace_ready{false};
+static void* s_trace_frames[MAX_TRACE_DEPTH];
+static int s_trace_depth = 0;
+
+// SIGURG 的处理函数，在被采样的线程上记录调用栈
+static void TraceSignalHandler(int)
+{
+    int saved_errno = errno;
+    long expected = GetThreadID();
+    // 请求已经超时被撤销，或者是其他来源的 SIGURG
+    if (s_trace_target.compare_exchange_strong(expected, 0, std::memory_order_acq_rel))
+    {
+        s_trace_depth = ::backtrace(s_trace_frames, MAX_TRACE_DEPTH);
+        s_trace_ready.store(true, std::memory_order_release);
+    }
+    errno = saved_errno;
+}
+
+// 安装信号处理函数，只执行一次
+static void InstallTraceHandler()
+{
+    static bool s_installed = []() {
+        // backtrace() 第一次调用时会加载 libgcc，提前调用，避免在信号处理函数中申请内存
+        void* frames[1];
+        ::backtrace(frames, 1);
+        struct sigaction action{};
+        action.sa_handler = TraceSignalHandler;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        return sigaction(SIGURG, &action, nullptr) == 0;
+    }();
+    (void)s_installed;
+}
+
+/**
+ * =========================================
+ * WatchdogImpl 类的实现
+ * =========================================
+*/
+
+WatchdogImpl::~WatchdogImpl()
+{
+    m_stopping = true;
+    if (m_thread)
+    {
+        m_thread->join();
+    }
+}
+
+void WatchdogImpl::add(Scheduler* scheduler)
+{
+    if (g_watchdog_interval_ms->getValue() <= 0)
+    {
+        return;
+    }
+    ScopedLock lock(&m_mutex);
+    if (std::find(m_schedulers.begin(), m_schedulers.end(), scheduler) == m_schedulers.end())
+    {
+        m_schedulers.push_back(scheduler);
+    }
+    // 第一个调度器启动时创建看门狗线程
+    if (!m_thread)
+    {
+        InstallTraceHandler();
+        m_thread = std::make_shared<Thread>([this]() { run(); }, "watchdog");
+    }
+}
+
+void WatchdogImpl::del(Scheduler* scheduler)
+{
+    // 采样在持有锁时进行，返回后看门狗不会再访问该调度器
+    ScopedLock lock(&m_mutex);
+    m_schedulers.erase(std::remove(m_schedulers.begin(), m_schedulers.end(), scheduler),
+                       m_schedulers.end());
+}
+
+std::string WatchdogImpl::captureBacktrace(long thread_id, uint64_t timeout_ms)
+{
+    if (thread_id <= 0)
+    {
+        return "";
+    }
+    ScopedLock lock(&m_trace_mutex);
+    s_trace_ready.store(false, std::memory_order_relaxed);
+    s_trace_target.store(thread_id, std::memory_order_release);
+    if (::syscall(SYS_tgkill, ::getpid(), thread_id, SIGURG) != 0)
+    {
+        s_trace_target.store(0, std::memory_order_relaxed);
+        return "";
+    }
+    uint64_t deadline = GetCurrentMS() + timeout_ms;
+    while (!s_trace_ready.load(std::memory_order_acquire))
+    {
+        if (GetCurrentMS() >= deadline)
+        {
+            // 撤销请求，撤销失败说明信号处理函数已经开始记录，等它完成
+            long expected = thread_id;
+            if (s_trace_target.compare_exchange_strong(expected, 0, std::memory_order_acq_rel))
+            {
+                return "";
+            }
+        }
+        sched_yield();
+    }
+    std::stringstream ss;
+    char** symbols = ::backtrace_symbols(s_trace_frames, s_trace_depth);
+    // 跳过信号处理函数和信号跳板
+    for (int i = 2; i < s_trace_depth; i++)
+    {
+        ss << "    " << (symbols ? symbols[i] : "??") << "\n";
+    }
+    free(symbols);
+    return ss.str();
+}
+
+void WatchdogImpl::run()
+{
+    while (!m_stopping)
+    {
+        int interval_ms = g_watchdog_interval_ms->getValue();
+        // 分段睡眠，进程退出时可以尽快结束
+        for (int slept = 0; slept < std::max(interval_ms, 10) && !m_stopping; slept += 10)
+        {
+            ::usleep(10 * 1000);
+        }
+        if (interval_ms <= 0 || m_stopping)
+        {
+            continue;
+        }
+        uint64_t threshold_ns = static_cast<uint64_t>(g_watchdog_threshold_ms->getValue()) * 1000000;
+        uint64_t now_ns = GetCurrentNS();
+        ScopedLock lock(&m_mutex);
+        for (Scheduler* scheduler : m_schedulers)
+        {
+            m_overruns += scheduler->checkOverruns(now_ns, threshold_ns);
+        }
+    }
+}
+
+} // namespace zjl
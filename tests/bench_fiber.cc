@@ -0,0 +1,117 @@
+#include "fiber.h"
+#include "fiber_context.h"
+#include "log.h"
+#include "util.h"
+#include <cstdio>
+#include <cstdlib>
+#include <ucontext.h>
+
+static const size_t s_stack_size = 64 * 1024;
+
+static void report(const char* name, uint64_t switches, uint64_t elapsed_ns)
+{
+    printf("%-24s switches = %9lu    %8.1f ns/switch    %12.0f switches/s\n",
+           name, switches, elapsed_ns * 1.0 / switches,
+           switches * 1000000000.0 / (elapsed_ns ? elapsed_ns : 1));
+}
+
+static ucontext_t s_uc_main;
+static ucontext_t s_uc_fiber;
+
+// 切回主上下文后立刻被换入，一直来回切换
+static void ucontextEntry()
+{
+    while (true)
+    {
+        swapcontext(&s_uc_fiber, &s_uc_main);
+    }
+}
+
+/**
+ * @brief 测量 swapcontext 在两个上下文之间来回切换的速度，每次切换都有一次 rt_sigprocmask 系统调用
+ * @param rounds 往返次数，每次往返切换两次
+ * */
+void BENCH_ucontext(uint64_t rounds)
+{
+    void* stack = ::malloc(s_stack_size);
+    getcontext(&s_uc_fiber);
+    s_uc_fiber.uc_link = nullptr;
+    s_uc_fiber.uc_stack.ss_sp = stack;
+    s_uc_fiber.uc_stack.ss_size = s_stack_size;
+    makecontext(&s_uc_fiber, &ucontextEntry, 0);
+    uint64_t begin = zjl::GetCurrentNS();
+    for (uint64_t i = 0; i < rounds; i++)
+    {
+        swapcontext(&s_uc_main, &s_uc_fiber);
+    }
+    report("ucontext", rounds * 2, zjl::GetCurrentNS() - begin);
+    ::free(stack);
+}
+
+#if ZJL_HAS_ASM_CONTEXT
+static void* s_asm_main = nullptr;
+static void* s_asm_fiber = nullptr;
+
+static void asmEntry()
+{
+    while (true)
+    {
+        zjl_swap_context(&s_asm_fiber, s_asm_main);
+    }
+}
+
+/**
+ * @brief 测量汇编实现的上下文切换在两个上下文之间来回切换的速度
+ * @param rounds 往返次数，每次往返切换两次
+ * */
+void BENCH_asm(uint64_t rounds)
+{
+    void* stack = ::malloc(s_stack_size);
+    s_asm_fiber = zjl::MakeAsmContext(stack, s_stack_size, &asmEntry);
+    uint64_t begin = zjl::GetCurrentNS();
+    for (uint64_t i = 0; i < rounds; i++)
+    {
+        zjl_swap_context(&s_asm_main, s_asm_fiber);
+    }
+    report("asm", rounds * 2, zjl::GetCurrentNS() - begin);
+    ::free(stack);
+}
+#endif
+
+/**
+ * @brief 测量 Fiber::call()/back() 的切换速度，使用编译时选择的后端
+ * @param rounds 往返次数，每次往返切换两次
+ * */
+void BENCH_fiber(uint64_t rounds)
+{
+    zjl::Fiber::GetThis();
+    zjl::Fiber::ptr fiber(new zjl::Fiber([rounds]() {
+        for (uint64_t i = 0; i < rounds; i++)
+        {
+            zjl::Fiber::Yield();
+        }
+    }, s_stack_size));
+    uint64_t begin = zjl::GetCurrentNS();
+    for (uint64_t i = 0; i < rounds; i++)
+    {
+        fiber->call();
+    }
+    uint64_t elapsed = zjl::GetCurrentNS() - begin;
+    // 让协程执行结束
+    fiber->call();
+    std::string name = std::string("Fiber (") + zjl::FiberContext::BackendName() + ")";
+    report(name.c_str(), rounds * 2, elapsed);
+}
+
+int main(int, char**)
+{
+    GET_ROOT_LOGGER()->setLevel(zjl::LogLevel::WARN);
+    const uint64_t rounds = 2000000;
+    printf("==== 协程上下文切换 ====\n");
+    BENCH_ucontext(rounds);
+#if ZJL_HAS_ASM_CONTEXT
+    BENCH_asm(rounds);
+#endif
+    BENCH_fiber(rounds);
+    return 0;
+}
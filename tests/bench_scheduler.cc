@@ -0,0 +1,271 @@
+#include "config.h"
+#include "io_manager.h"
+#include "log.h"
+#include "scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static std::atomic_uint64_t s_done{0};
+
+// 每个生产任务在调度线程内派生若干个小任务，派生的任务进入本地队列，由其他线程窃取
+static void spawner(zjl::Scheduler* sc, uint64_t children, bool inline_run = false)
+{
+    for (uint64_t i = 0; i < children; i++)
+    {
+        if (inline_run)
+        {
+            sc->scheduleInline([]() { ++s_done; });
+        }
+        else
+        {
+            sc->schedule([]() { ++s_done; });
+        }
+    }
+}
+
+/**
+ * @brief 测量不同线程数下调度器每秒执行的任务数
+ * @param thread_count 调度线程数量
+ * @param spawners 生产任务的数量
+ * @param children 每个生产任务派生的任务数量
+ * */
+void BENCH_throughput(size_t thread_count, uint64_t spawners, uint64_t children)
+{
+    s_done = 0;
+    uint64_t begin = zjl::GetCurrentUS();
+    {
+        zjl::Scheduler sc(thread_count, false, "bench");
+        sc.start();
+        for (uint64_t i = 0; i < spawners; i++)
+        {
+            sc.schedule([&sc, children]() { spawner(&sc, children); });
+        }
+        sc.stop();
+    }
+    uint64_t elapsed = zjl::GetCurrentUS() - begin;
+    uint64_t total = s_done;
+    printf("threads = %3zu    tasks = %8lu    time = %8.2f ms    %10.0f tasks/s\n",
+           thread_count, total, elapsed / 1000.0,
+           total * 1000000.0 / (elapsed ? elapsed : 1));
+}
+
+/**
+ * @brief 测量短回调任务的吞吐量，对比每个任务新建协程与复用执行结束的协程
+ * @param allocator 配置项 fiber.stack_allocator 的值
+ * @param cache_size 配置项 scheduler.fiber_cache_size 的值，为 0 时每个回调任务都创建新协程
+ * */
+void BENCH_fiberCache(const std::string& allocator, int cache_size)
+{
+    zjl::Config::Lookup<std::string>("fiber.stack_allocator")->setValue(allocator);
+    zjl::Config::Lookup<int>("scheduler.fiber_cache_size")->setValue(cache_size);
+    s_done = 0;
+    uint64_t begin = zjl::GetCurrentUS();
+    {
+        zjl::Scheduler sc(1, false, "bench");
+        sc.start();
+        for (uint64_t i = 0; i < 64; i++)
+        {
+            sc.schedule([&sc]() { spawner(&sc, 2000); });
+        }
+        sc.stop();
+    }
+    uint64_t elapsed = zjl::GetCurrentUS() - begin;
+    uint64_t total = s_done;
+    printf("stack = %-6s    cache = %3d    tasks = %8lu    time = %8.2f ms    %10.0f tasks/s\n",
+           allocator.c_str(), cache_size, total, elapsed / 1000.0,
+           total * 1000000.0 / (elapsed ? elapsed : 1));
+}
+
+/**
+ * @brief 测量短回调任务的吞吐量，对比在协程中执行与在调度协程上内联执行
+ * @param inline_run 是否使用 scheduleInline() 派生任务
+ * */
+void BENCH_inlineCallback(bool inline_run)
+{
+    s_done = 0;
+    uint64_t begin = zjl::GetCurrentUS();
+    {
+        zjl::Scheduler sc(1, false, "bench");
+        sc.start();
+        for (uint64_t i = 0; i < 64; i++)
+        {
+            sc.schedule([&sc, inline_run]() { spawner(&sc, 2000, inline_run); });
+        }
+        sc.stop();
+    }
+    uint64_t elapsed = zjl::GetCurrentUS() - begin;
+    uint64_t total = s_done;
+    printf("%-8s    tasks = %8lu    time = %8.2f ms    %10.0f tasks/s\n",
+           inline_run ? "inline" : "fiber", total, elapsed / 1000.0,
+           total * 1000000.0 / (elapsed ? elapsed : 1));
+}
+
+/**
+ * @brief 测量多个外部线程并发提交任务时，单次 schedule() 调用的耗时
+ * @param producer_count 提交任务的外部线程数量
+ * @param per_producer 每个线程提交的任务数量
+ * */
+void BENCH_submitLatency(size_t producer_count, uint64_t per_producer)
+{
+    s_done = 0;
+    std::vector<std::vector<uint64_t>> samples(producer_count);
+    {
+        zjl::Scheduler sc(4, false, "bench");
+        sc.start();
+        std::vector<zjl::Thread::uptr> producers;
+        for (size_t i = 0; i < producer_count; i++)
+        {
+            auto& sample = samples[i];
+            producers.push_back(std::make_unique<zjl::Thread>(
+                [&sc, &sample, per_producer]() {
+                    sample.reserve(per_producer);
+                    for (uint64_t j = 0; j < per_producer; j++)
+                    {
+                        uint64_t begin = zjl::GetCurrentNS();
+                        sc.schedule([]() { ++s_done; });
+                        sample.push_back(zjl::GetCurrentNS() - begin);
+                    }
+                },
+                "producer_" + std::to_string(i)));
+        }
+        for (auto& t : producers)
+        {
+            t->join();
+        }
+        sc.stop();
+    }
+    std::vector<uint64_t> all;
+    for (auto& sample : samples)
+    {
+        all.insert(all.end(), sample.begin(), sample.end());
+    }
+    std::sort(all.begin(), all.end());
+    uint64_t sum = 0;
+    for (auto v : all)
+    {
+        sum += v;
+    }
+    printf("producers = %3zu    submits = %8zu    avg = %8.1f ns    p50 = %6lu ns    p99 = %6lu ns    max = %8lu ns\n",
+           producer_count, all.size(), sum * 1.0 / all.size(),
+           all[all.size() / 2], all[all.size() * 99 / 100], all.back());
+}
+
+/**
+ * @brief 测量外部线程提交的任务的执行吞吐量，任务全部经过共享队列
+ * @param thread_count 调度线程数量
+ * @param batch_size 配置项 scheduler.batch_size 的值，为 1 时每次加锁只取一个任务
+ * @param producer_count 提交任务的外部线程数量
+ * @param per_producer 每个线程提交的任务数量
+ * */
+void BENCH_sharedQueueDequeue(size_t thread_count, int batch_size,
+                              size_t producer_count, uint64_t per_producer)
+{
+    zjl::Config::Lookup<int>("scheduler.batch_size")->setValue(batch_size);
+    s_done = 0;
+    uint64_t begin = zjl::GetCurrentUS();
+    {
+        zjl::Scheduler sc(thread_count, false, "bench");
+        sc.start();
+        std::vector<zjl::Thread::uptr> producers;
+        for (size_t i = 0; i < producer_count; i++)
+        {
+            producers.push_back(std::make_unique<zjl::Thread>(
+                [&sc, per_producer]() {
+                    for (uint64_t j = 0; j < per_producer; j++)
+                    {
+                        sc.schedule([]() { ++s_done; });
+                    }
+                },
+                "producer_" + std::to_string(i)));
+        }
+        for (auto& t : producers)
+        {
+            t->join();
+        }
+        sc.stop();
+    }
+    uint64_t elapsed = zjl::GetCurrentUS() - begin;
+    uint64_t total = s_done;
+    printf("threads = %3zu    batch = %3d    tasks = %8lu    time = %8.2f ms    %10.0f tasks/s\n",
+           thread_count, batch_size, total, elapsed / 1000.0,
+           total * 1000000.0 / (elapsed ? elapsed : 1));
+}
+
+/**
+ * @brief 测量调度线程空闲时，从提交任务到任务开始执行的唤醒延迟
+ * @param spin_us 配置项 iomanager.idle_spin_us 的值，为 0 时空闲线程直接进入 epoll_wait
+ * @param gap_us 相邻两次提交之间的间隔
+ * @param count 提交次数
+ * */
+void BENCH_wakeupLatency(int spin_us, useconds_t gap_us, size_t count)
+{
+    zjl::Config::Lookup<int>("iomanager.idle_spin_us")->setValue(spin_us);
+    std::atomic_uint64_t run_ns{0};
+    std::vector<uint64_t> samples;
+    samples.reserve(count);
+    {
+        zjl::IOManager iom(2, false, "bench");
+        for (size_t i = 0; i < count; i++)
+        {
+            usleep(gap_us);
+            run_ns = 0;
+            uint64_t begin = zjl::GetCurrentNS();
+            iom.schedule([&run_ns]() { run_ns = zjl::GetCurrentNS(); });
+            while (run_ns == 0)
+            {
+            }
+            samples.push_back(run_ns - begin);
+        }
+    }
+    std::sort(samples.begin(), samples.end());
+    printf("spin = %3d us    gap = %4u us    p50 = %8lu ns    p99 = %8lu ns\n",
+           spin_us, gap_us, samples[samples.size() / 2], samples[samples.size() * 99 / 100]);
+}
+
+int main(int, char**)
+{
+    // 关掉调度器的调试日志，避免日志输出影响测量结果
+    GET_ROOT_LOGGER()->setLevel(zjl::LogLevel::WARN);
+    std::vector<size_t> thread_counts{1, 2, 4, 8, 16, 32};
+    printf("==== Scheduler 吞吐量 ====\n");
+    for (auto n : thread_counts)
+    {
+        BENCH_throughput(n, 64, 2000);
+    }
+    printf("==== 回调任务复用协程 ====\n");
+    BENCH_fiberCache("malloc", 0);
+    BENCH_fiberCache("mmap", 0);
+    BENCH_fiberCache("mmap", 16);
+    zjl::Config::Lookup<std::string>("fiber.stack_allocator")->setValue("mmap");
+    printf("==== 回调任务内联执行 ====\n");
+    BENCH_inlineCallback(false);
+    BENCH_inlineCallback(true);
+    printf("==== Scheduler 跨线程提交延迟 ====\n");
+    for (auto n : {1, 2, 4, 8})
+    {
+        BENCH_submitLatency(n, 20000);
+    }
+    printf("==== 共享队列逐个取出与成批取出 ====\n");
+    for (auto n : {1, 2, 4, 8, 16, 32, 64})
+    {
+        for (int batch_size : {1, 32})
+        {
+            BENCH_sharedQueueDequeue(n, batch_size, 4, 50000);
+        }
+    }
+    zjl::Config::Lookup<int>("scheduler.batch_size")->setValue(32);
+    printf("==== IOManager 空闲线程唤醒延迟 ====\n");
+    for (int spin_us : {0, 50})
+    {
+        for (useconds_t gap_us : {20u, 200u})
+        {
+            BENCH_wakeupLatency(spin_us, gap_us, 2000);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include "channel.h"
+#include "io_manager.h"
+#include "log.h"
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 多级流水线：生产者 -> 平方 -> 汇总，容量很小，发送和接收都会频繁挂起
+void TEST_pipeline()
+{
+    const int producers = 8;
+    const int per_producer = 2000;
+    zjl::Channel<int> numbers(4);
+    zjl::Channel<uint64_t> squares(4);
+    std::atomic_int producers_left{producers};
+    std::atomic_int squarers_left{4};
+    uint64_t sum = 0;
+    std::atomic_bool finished{false};
+    {
+        zjl::IOManager iom(4, false, "pipeline");
+        for (int i = 0; i < producers; i++)
+        {
+            iom.schedule([&]() {
+                for (int j = 1; j <= per_producer; j++)
+                {
+                    bool ok = numbers.send(j);
+                    assert(ok);
+                }
+                if (--producers_left == 0)
+                {
+                    numbers.close();
+                }
+            });
+        }
+        for (int i = 0; i < 4; i++)
+        {
+            iom.schedule([&]() {
+                int value;
+                while (numbers.recv(value))
+                {
+                    squares.send(static_cast<uint64_t>(value) * value);
+                }
+                if (--squarers_left == 0)
+                {
+                    squares.close();
+                }
+            });
+        }
+        iom.schedule([&]() {
+            uint64_t value;
+            while (squares.recv(value))
+            {
+                sum += value;
+            }
+            finished = true;
+        });
+    }
+    uint64_t n = per_producer;
+    uint64_t expected = producers * (n * (n + 1) * (2 * n + 1) / 6);
+    std::cout << "pipeline sum = " << sum << ", expected = " << expected << std::endl;
+    assert(finished);
+    assert(sum == expected);
+    assert(!numbers.send(1));
+}
+
+// select 同时等待两个通道，两个通道都关闭后结束
+void TEST_select()
+{
+    zjl::Channel<int> ints(2);
+    zjl::Channel<std::string> strings(2);
+    std::atomic_int int_count{0};
+    std::atomic_int string_count{0};
+    {
+        zjl::IOManager iom(4, false, "select");
+        iom.schedule([&]() {
+            for (int i = 0; i < 1000; i++)
+            {
+                ints.send(i);
+            }
+            ints.close();
+        });
+        iom.schedule([&]() {
+            for (int i = 0; i < 500; i++)
+            {
+                strings.send(std::to_string(i));
+            }
+            strings.close();
+        });
+        iom.schedule([&]() {
+            bool ints_open = true;
+            bool strings_open = true;
+            while (ints_open || strings_open)
+            {
+                int value = 0;
+                std::string text;
+                bool ok = false;
+                zjl::ChannelSelect select;
+                if (ints_open)
+                {
+                    select.recv(ints, value, &ok);
+                }
+                if (strings_open)
+                {
+                    select.recv(strings, text, &ok);
+                }
+                int index = select.wait();
+                bool is_int = ints_open && index == 0;
+                if (!ok)
+                {
+                    (is_int ? ints_open : strings_open) = false;
+                    continue;
+                }
+                if (is_int)
+                {
+                    ++int_count;
+                }
+                else
+                {
+                    ++string_count;
+                }
+            }
+        });
+    }
+    std::cout << "select ints = " << int_count << ", strings = " << string_count << std::endl;
+    assert(int_count == 1000);
+    assert(string_count == 500);
+}
+
+// 带超时的接收，超时返回 false，期间收到数据则立刻返回
+void TEST_timeout()
+{
+    zjl::Channel<int> channel(1);
+    uint64_t waited = 0;
+    bool timed_out = false;
+    bool received = false;
+    {
+        zjl::IOManager iom(2, false, "timeout");
+        iom.schedule([&]() {
+            int value;
+            uint64_t begin = zjl::GetCurrentMS();
+            timed_out = !channel.recv(value, 50);
+            waited = zjl::GetCurrentMS() - begin;
+            iom.addTimer(20, [&channel]() { channel.send(7); });
+            value = 0;
+            received = channel.recv(value, 1000) && value == 7;
+        });
+    }
+    std::cout << "recv timeout after " << waited << " ms" << std::endl;
+    assert(timed_out);
+    assert(waited >= 45);
+    assert(received);
+}
+
+// 不在调度器中时退化为阻塞线程
+void TEST_threadFallback()
+{
+    zjl::Channel<int> channel(8);
+    uint64_t sum = 0;
+    zjl::Thread consumer([&]() {
+        int value;
+        while (channel.recv(value))
+        {
+            sum += value;
+        }
+    }, "consumer");
+    for (int i = 1; i <= 10000; i++)
+    {
+        channel.send(i);
+    }
+    channel.close();
+    consumer.join();
+    std::cout << "thread sum = " << sum << std::endl;
+    assert(sum == 10000ul * 10001 / 2);
+}
+
+// 只能移动的元素：阻塞发送与 select 发送都不需要拷贝
+void TEST_moveOnly()
+{
+    zjl::Channel<std::unique_ptr<int>> channel(2);
+    uint64_t sum = 0;
+    {
+        zjl::IOManager iom(2, false, "move_only");
+        iom.schedule([&]() {
+            for (int i = 1; i <= 1000; i++)
+            {
+                bool ok = channel.send(std::make_unique<int>(i));
+                assert(ok);
+            }
+            bool ok = false;
+            zjl::ChannelSelect select;
+            select.send(channel, std::make_unique<int>(1001), &ok);
+            int index = select.wait();
+            assert(index == 0 && ok);
+            channel.close();
+        });
+        iom.schedule([&]() {
+            std::unique_ptr<int> value;
+            while (channel.recv(value))
+            {
+                sum += *value;
+            }
+        });
+    }
+    std::cout << "move-only sum = " << sum << std::endl;
+    assert(sum == 1001ul * 1002 / 2);
+}
+
+int main(int, char**)
+{
+    GET_ROOT_LOGGER()->setLevel(zjl::LogLevel::WARN);
+    TEST_pipeline();
+    TEST_select();
+    TEST_timeout();
+    TEST_threadFallback();
+    TEST_moveOnly();
+    return 0;
+}
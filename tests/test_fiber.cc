@@ -1,8 +1,18 @@
 #include "fiber.h"
+#include "io_manager.h"
+#include "stack_allocator.h"
 #include <iostream>
 #include <memory>
 #include <cstdio>
 #include <array>
+#include <atomic>
+#include <cassert>
+#include <csignal>
+#include <cstring>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
 
 int fib = 0;
 
@@ -46,8 +56,138 @@ void test(char c)
     }
 }
 
+// 释放的栈被下一次分配复用，越过栈底写入保护页触发 SIGSEGV
+void TEST_stackPool()
+{
+    auto allocator = zjl::MmapStackAllocator::GetInstance();
+    auto before = allocator->getStats();
+    void* stack = allocator->alloc(64 * 1024);
+    allocator->dealloc(stack, 64 * 1024);
+    void* reused = allocator->alloc(64 * 1024);
+    auto after = allocator->getStats();
+    std::cout << "stack pool: reused = " << (stack == reused)
+              << ", local hits = " << after.local_hits - before.local_hits << std::endl;
+    assert(stack == reused);
+    assert(after.local_hits == before.local_hits + 1);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        static_cast<volatile char*>(reused)[-1] = 1;
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    std::cout << "stack pool: guard page signal = " << (WIFSIGNALED(status) ? WTERMSIG(status) : 0) << std::endl;
+    assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+    allocator->dealloc(reused, 64 * 1024);
+}
+
+static int recurse(int depth)
+{
+    volatile char buffer[1024];
+    buffer[0] = static_cast<char>(depth);
+    return depth == 0 ? 0 : recurse(depth - 1) + buffer[0];
+}
+
+// 64 KiB 的协程栈上无限递归，子进程输出协程 id 与调用栈后以 SIGABRT 终止
+void TEST_stackOverflow()
+{
+    int fds[2];
+    assert(pipe(fds) == 0);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        dup2(fds[1], STDOUT_FILENO);
+        zjl::Fiber::GetThis();
+        auto fiber = std::make_shared<zjl::Fiber>([]() { recurse(1000000); }, 64 * 1024);
+        fiber->call();
+        _exit(0);
+    }
+    close(fds[1]);
+    std::string output;
+    char buffer[4096];
+    ssize_t n = 0;
+    while ((n = read(fds[0], buffer, sizeof(buffer))) > 0)
+    {
+        output.append(buffer, n);
+    }
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    std::cout << "stack overflow: signal = " << (WIFSIGNALED(status) ? WTERMSIG(status) : 0)
+              << ", output:\n" << output.substr(0, 400) << std::endl;
+    assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+    assert(output.find("协程栈溢出") != std::string::npos);
+    assert(output.find("call stack") != std::string::npos);
+}
+
+// 在栈上填充与 id 相关的内容，让出若干次，每次恢复后检查内容没有被其他协程覆盖
+static bool checkStack(int id, int rounds, void (*yield)())
+{
+    char buffer[8 * 1024];
+    memset(buffer, id, sizeof(buffer));
+    for (int i = 0; i < rounds; i++)
+    {
+        yield();
+        for (char c : buffer)
+        {
+            if (c != static_cast<char>(id))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// 共享栈协程交替执行时各自的栈内容保持不变，可以在调度器的多个线程之间迁移
+void TEST_sharedStack()
+{
+    zjl::Fiber::GetThis();
+    // 当前线程只有一块共享栈，三个协程轮流使用
+    zjl::Config::Lookup<uint64_t>("fiber.shared_stack_count")->setValue(1);
+    std::vector<zjl::Fiber::ptr> fibers;
+    std::atomic_int passed{0};
+    for (int i = 0; i < 3; i++)
+    {
+        fibers.push_back(std::make_shared<zjl::Fiber>([i, &passed]() {
+            passed += checkStack(i + 1, 5, &zjl::Fiber::Yield);
+        }, 0, true));
+    }
+    for (int round = 0; round < 6; round++)
+    {
+        for (auto& fiber : fibers)
+        {
+            fiber->call();
+        }
+    }
+    for (auto& fiber : fibers)
+    {
+        assert(fiber->finish());
+    }
+    std::cout << "shared stack: call/back passed = " << passed << std::endl;
+    assert(passed == 3);
+
+    passed = 0;
+    {
+        zjl::IOManager iom(4, false, "shared_stack");
+        for (int i = 0; i < 200; i++)
+        {
+            iom.schedule(std::make_shared<zjl::Fiber>([i, &passed]() {
+                passed += checkStack(i % 100 + 1, 3, []() { usleep(5 * 1000); });
+            }, 0, true));
+        }
+    }
+    std::cout << "shared stack: scheduler passed = " << passed << std::endl;
+    assert(passed == 200);
+}
+
 int main(int, char**)
 {
+   TEST_stackPool();
+   TEST_stackOverflow();
+   TEST_sharedStack();
    zjl::Fiber::GetThis();
    {
        auto fiber = std::make_shared<zjl::Fiber>(fiberFunc);
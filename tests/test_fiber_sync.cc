@@ -0,0 +1,211 @@
+#include "fiber_sync.h"
+#include "log.h"
+#include "scheduler.h"
+#include <atomic>
+#include <cassert>
+#include <deque>
+#include <iostream>
+#include <vector>
+
+// 让出当前协程，并立刻把自己重新加入调度，制造更多的交错
+static void YieldToReady()
+{
+    zjl::Scheduler::GetThis()->schedule(zjl::Fiber::GetThis());
+    zjl::Fiber::YieldToHold();
+}
+
+// 多个协程竞争同一把锁累加计数
+void TEST_mutex()
+{
+    zjl::FiberMutex mutex;
+    uint64_t counter = 0;
+    {
+        zjl::Scheduler sc(4, false, "mutex");
+        sc.start();
+        for (int i = 0; i < 64; i++)
+        {
+            sc.schedule([&mutex, &counter]() {
+                for (int j = 0; j < 1000; j++)
+                {
+                    zjl::FiberScopedLock lock(&mutex);
+                    uint64_t value = counter;
+                    if (j % 100 == 0)
+                    { // 持有锁时让出，其他协程只能挂起等待
+                        YieldToReady();
+                    }
+                    counter = value + 1;
+                }
+            });
+        }
+        sc.stop();
+    }
+    std::cout << "FiberMutex counter = " << counter << std::endl;
+    assert(counter == 64 * 1000);
+}
+
+// 生产者消费者，消费者在队列为空时挂起
+void TEST_condVar()
+{
+    zjl::FiberMutex mutex;
+    zjl::FiberCondVar cond;
+    std::deque<int> queue;
+    std::atomic_uint64_t sum{0};
+    const int producers = 8;
+    const int per_producer = 1000;
+    {
+        zjl::Scheduler sc(4, false, "cond");
+        sc.start();
+        for (int i = 0; i < producers; i++)
+        {
+            sc.schedule([&]() {
+                for (int j = 0; j < per_producer; j++)
+                {
+                    {
+                        zjl::FiberScopedLock lock(&mutex);
+                        queue.push_back(j);
+                    }
+                    cond.notifyOne();
+                }
+            });
+            sc.schedule([&]() {
+                for (int j = 0; j < per_producer; j++)
+                {
+                    mutex.lock();
+                    cond.wait(mutex, [&queue]() { return !queue.empty(); });
+                    int value = queue.front();
+                    queue.pop_front();
+                    mutex.unlock();
+                    sum += value;
+                }
+            });
+        }
+        sc.stop();
+    }
+    uint64_t expected = producers * (per_producer * (per_producer - 1) / 2);
+    std::cout << "FiberCondVar sum = " << sum << ", expected = " << expected << std::endl;
+    assert(sum == expected);
+}
+
+// 同时进入临界区的协程数量不超过信号量的初始值
+void TEST_semaphore()
+{
+    const int limit = 3;
+    zjl::FiberSemaphore sem(limit);
+    std::atomic_int inside{0};
+    std::atomic_int max_inside{0};
+    std::atomic_int done{0};
+    {
+        zjl::Scheduler sc(4, false, "sem");
+        sc.start();
+        for (int i = 0; i < 32; i++)
+        {
+            sc.schedule([&]() {
+                for (int j = 0; j < 100; j++)
+                {
+                    sem.wait();
+                    int now = ++inside;
+                    int max = max_inside;
+                    while (now > max && !max_inside.compare_exchange_weak(max, now))
+                    {
+                    }
+                    YieldToReady();
+                    --inside;
+                    sem.notify();
+                }
+                ++done;
+            });
+        }
+        sc.stop();
+    }
+    std::cout << "FiberSemaphore max inside = " << max_inside << std::endl;
+    assert(done == 32);
+    assert(max_inside <= limit);
+    assert(sem.tryWait());
+}
+
+// 写锁与读锁、写锁互斥，读锁之间可以并发
+void TEST_rwLock()
+{
+    zjl::FiberRWLock lock;
+    std::atomic_int readers{0};
+    std::atomic_int writers{0};
+    std::atomic_bool violated{false};
+    uint64_t value = 0;
+    {
+        zjl::Scheduler sc(4, false, "rwlock");
+        sc.start();
+        for (int i = 0; i < 32; i++)
+        {
+            bool is_writer = i % 4 == 0;
+            sc.schedule([&, is_writer]() {
+                for (int j = 0; j < 200; j++)
+                {
+                    if (is_writer)
+                    {
+                        zjl::FiberWriteScopedLock guard(&lock);
+                        if (++writers != 1 || readers != 0)
+                        {
+                            violated = true;
+                        }
+                        uint64_t old = value;
+                        YieldToReady();
+                        value = old + 1;
+                        --writers;
+                    }
+                    else
+                    {
+                        zjl::FiberReadScopedLock guard(&lock);
+                        ++readers;
+                        if (writers != 0)
+                        {
+                            violated = true;
+                        }
+                        YieldToReady();
+                        --readers;
+                    }
+                }
+            });
+        }
+        sc.stop();
+    }
+    std::cout << "FiberRWLock value = " << value << std::endl;
+    assert(!violated);
+    assert(value == 8 * 200);
+}
+
+// 不在调度器中时退化为阻塞线程
+void TEST_threadFallback()
+{
+    zjl::FiberMutex mutex;
+    uint64_t counter = 0;
+    std::vector<zjl::Thread::uptr> threads;
+    for (int i = 0; i < 4; i++)
+    {
+        threads.push_back(std::make_unique<zjl::Thread>(
+            [&mutex, &counter]() {
+                for (int j = 0; j < 10000; j++)
+                {
+                    zjl::FiberScopedLock lock(&mutex);
+                    ++counter;
+                }
+            },
+            "fallback_" + std::to_string(i)));
+    }
+    for (auto& t : threads)
+    {
+        t->join();
+    }
+    std::cout << "线程中使用 FiberMutex counter = " << counter << std::endl;
+    assert(counter == 4 * 10000);
+}
+
+int main(int, char**)
+{
+    GET_ROOT_LOGGER()->setLevel(zjl::LogLevel::WARN);
+    TEST_mutex();
+    TEST_condVar();
+    TEST_semaphore();
+    TEST_rwLock();
+    TEST_threadFallback();
+    return 0;
+}
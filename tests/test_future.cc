@@ -0,0 +1,113 @@
+#include "future.h"
+#include "io_manager.h"
+#include "log.h"
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// 分发多个子任务并汇总结果，汇总的协程等待时不占用调度线程
+void TEST_scatterGather()
+{
+    uint64_t sum = 0;
+    {
+        zjl::IOManager iom(2, false, "gather");
+        iom.schedule([&iom, &sum]() {
+            std::vector<zjl::Future<uint64_t>> futures;
+            for (uint64_t i = 0; i < 64; i++)
+            {
+                futures.push_back(iom.scheduleWithResult([&iom, i]() {
+                    // 模拟等待后端响应
+                    zjl::Promise<void> delay;
+                    auto done = delay.getFuture();
+                    auto promise = std::make_shared<zjl::Promise<void>>(std::move(delay));
+                    iom.addTimer(10, [promise]() { promise->setValue(); });
+                    done.wait();
+                    return i * i;
+                }));
+            }
+            for (auto& future : futures)
+            {
+                sum += future.get();
+            }
+        });
+    }
+    std::cout << "scatter/gather sum = " << sum << std::endl;
+    assert(sum == 63ul * 64 * 127 / 6);
+}
+
+// 异常、void 结果以及没有设置结果的 Promise
+void TEST_exception()
+{
+    zjl::IOManager iom(2, false, "exception");
+    auto failed = iom.scheduleWithResult([]() -> int {
+        throw std::runtime_error("backend unavailable");
+    });
+    std::atomic_bool ran{false};
+    auto nothing = iom.scheduleWithResult([&ran]() { ran = true; });
+    zjl::Future<std::string> broken;
+    {
+        zjl::Promise<std::string> promise;
+        broken = promise.getFuture();
+    }
+    // 主线程不在调度器中，等待时阻塞线程
+    bool caught = false;
+    try
+    {
+        failed.get();
+    }
+    catch (const std::runtime_error& e)
+    {
+        caught = std::string(e.what()) == "backend unavailable";
+    }
+    nothing.get();
+    bool broken_caught = false;
+    try
+    {
+        broken.get();
+    }
+    catch (const zjl::Exception&)
+    {
+        broken_caught = true;
+    }
+    std::cout << "exception caught = " << caught << ", broken promise caught = " << broken_caught << std::endl;
+    assert(caught);
+    assert(ran);
+    assert(broken_caught);
+}
+
+// WaitGroup 等待一组任务完成
+void TEST_waitGroup()
+{
+    std::atomic_int done{0};
+    bool all_done = false;
+    {
+        zjl::IOManager iom(4, false, "wait_group");
+        iom.schedule([&]() {
+            zjl::WaitGroup wg;
+            for (int i = 0; i < 100; i++)
+            {
+                wg.add();
+                iom.schedule([&wg, &done]() {
+                    ++done;
+                    wg.done();
+                });
+            }
+            wg.wait();
+            all_done = done == 100;
+        });
+    }
+    std::cout << "WaitGroup all done = " << all_done << std::endl;
+    assert(all_done);
+}
+
+int main(int, char**)
+{
+    GET_ROOT_LOGGER()->setLevel(zjl::LogLevel::WARN);
+    TEST_scatterGather();
+    TEST_exception();
+    TEST_waitGroup();
+    return 0;
+}
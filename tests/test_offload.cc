@@ -0,0 +1,107 @@
+#include "io_manager.h"
+#include "log.h"
+#include "offload.h"
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// 卸载的阻塞调用不占用调度线程，完成后协程回到原来的调度器
+void TEST_offload()
+{
+    zjl::OffloadPool pool(4, 16, "blocking");
+    std::atomic_int resumed{0};
+    std::atomic_uint64_t ticks{0};
+    std::atomic_bool finished{false};
+    {
+        zjl::IOManager iom(1, false, "offload_caller");
+        for (int i = 0; i < 4; i++)
+        {
+            iom.schedule([&, i]() {
+                // 卸载线程没有开启 hook，usleep 会真正阻塞线程
+                int value = pool.offload([i]() {
+                    usleep(100 * 1000);
+                    return i * 10;
+                });
+                if (value == i * 10 && zjl::Scheduler::GetThis() == &iom)
+                {
+                    ++resumed;
+                }
+                if (resumed == 4)
+                {
+                    finished = true;
+                }
+            });
+        }
+        // 唯一的调度线程在阻塞调用期间仍然可以执行其他协程
+        iom.schedule([&]() {
+            while (!finished)
+            {
+                ++ticks;
+                usleep(1000);
+            }
+        });
+    }
+    std::cout << "offload: resumed = " << resumed << ", ticks = " << ticks
+              << ", " << pool.getStats().toString() << std::endl;
+    assert(resumed == 4);
+    assert(ticks > 20);
+}
+
+// 队列已满时提交者等待空位，trySubmit() 直接失败
+void TEST_backpressure()
+{
+    zjl::OffloadPool pool(1, 2, "narrow");
+    std::atomic_int sum{0};
+    bool rejected = false;
+    bool caught = false;
+    {
+        zjl::IOManager iom(2, false, "offload_backpressure");
+        // 挂起在 Future 上的协程不算调度器的任务，主线程等待它结束后再停止调度器
+        auto done = iom.scheduleWithResult([&]() {
+            std::vector<zjl::Future<void>> futures;
+            for (int i = 1; i <= 10; i++)
+            {
+                futures.push_back(pool.submit([&sum, i]() {
+                    usleep(10 * 1000);
+                    sum += i;
+                }));
+            }
+            zjl::Future<int> extra;
+            rejected = !pool.trySubmit([]() { return 0; }, extra);
+            for (auto& future : futures)
+            {
+                future.get();
+            }
+            try
+            {
+                pool.offload([]() { throw std::runtime_error("disk error"); });
+            }
+            catch (const std::runtime_error& e)
+            {
+                caught = std::string(e.what()) == "disk error";
+            }
+        });
+        done.get();
+    }
+    zjl::OffloadPool::Stats stats = pool.getStats();
+    std::cout << "backpressure: sum = " << sum << ", " << stats.toString() << std::endl;
+    assert(sum == 55);
+    assert(rejected);
+    assert(caught);
+    assert(stats.blocked > 0);
+    assert(stats.rejected == 1);
+    assert(stats.max_queue_depth <= 2);
+    assert(stats.submitted == 11);
+}
+
+int main(int, char**)
+{
+    GET_ROOT_LOGGER()->setLevel(zjl::LogLevel::WARN);
+    TEST_offload();
+    TEST_backpressure();
+    return 0;
+}
@@ -1,6 +1,41 @@
+#include "config.h"
+#include "hook.h"
+#include "io_manager.h"
 #include "log.h"
 #include "scheduler.h"
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
 #include <iostream>
+#include <new>
+#include <sched.h>
+#include <set>
+#include <unistd.h>
+#include <vector>
+
+// 每条线程调用 operator new 的次数
+static thread_local uint64_t t_alloc_count = 0;
+
+void* operator new(size_t size)
+{
+    ++t_alloc_count;
+    void* ptr = std::malloc(size);
+    if (!ptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
 
 void fn()
 {
@@ -20,8 +55,331 @@ void fn2()
     }
 }
 
+// 测试稳定运行时，调度一个 lambda 不会在调用线程上申请内存
+void TEST_taskAllocation()
+{
+    std::atomic_uint64_t done{0};
+    zjl::Scheduler sc(2, false, "alloc");
+    sc.start();
+    auto submit = [&sc, &done](uint64_t count) {
+        for (uint64_t i = 0; i < count; i++)
+        {
+            sc.schedule([&done, i]() {
+                done += i;
+            });
+        }
+    };
+    // 预热，让任务节点对象池里存有足够的空闲节点
+    submit(4096);
+    while (done < 4096ul * 4095 / 2)
+    {
+        sched_yield();
+    }
+    uint64_t before = t_alloc_count;
+    submit(1000);
+    uint64_t after = t_alloc_count;
+    sc.stop();
+    std::cout << "调度 1000 个任务，调用线程申请内存 " << after - before << " 次" << std::endl;
+    assert(after == before);
+}
+
+// 测试高优先级任务先执行，同时低优先级任务按权重轮到，不会被饿死
+void TEST_priority()
+{
+    using zjl::Scheduler;
+    std::vector<Scheduler::Priority> order;
+    zjl::Scheduler sc(1, true, "priority");
+    sc.start();
+    for (int i = 0; i < 20; i++)
+    {
+        for (auto priority : {Scheduler::PRIORITY_LOW, Scheduler::PRIORITY_NORMAL, Scheduler::PRIORITY_HIGH})
+        {
+            sc.schedule([&order, priority]() { order.push_back(priority); }, -1, priority);
+        }
+    }
+    assert(sc.getQueueDepth(Scheduler::PRIORITY_HIGH) == 20);
+    assert(sc.getQueueDepth(Scheduler::PRIORITY_NORMAL) == 20);
+    assert(sc.getQueueDepth(Scheduler::PRIORITY_LOW) == 20);
+    // 只有主线程一条调度线程，stop() 时按顺序执行所有任务
+    sc.stop();
+    assert(order.size() == 60);
+    assert(sc.getQueueDepth(Scheduler::PRIORITY_LOW) == 0);
+    assert(order.front() == Scheduler::PRIORITY_HIGH);
+    // 默认权重为 {8, 4, 1}，前 13 个任务中一定有一个低优先级任务
+    size_t first_low = 0;
+    while (order[first_low] != Scheduler::PRIORITY_LOW)
+    {
+        ++first_low;
+    }
+    std::cout << "第一个低优先级任务是第 " << first_low + 1 << " 个执行的" << std::endl;
+    assert(first_low < 13);
+}
+
+// 让出的协程按原来的优先级重新加入调度
+void TEST_yieldKeepsPriority()
+{
+    using zjl::Scheduler;
+    size_t low_depth = 0;
+    size_t normal_depth = 0;
+    Scheduler sc(1, false, "yield_priority");
+    sc.start();
+    sc.schedule([&]() {
+        // 高优先级任务在低优先级任务让出之后执行，此时低优先级任务已经重新入队
+        Scheduler::GetThis()->schedule([&]() {
+            low_depth = Scheduler::GetThis()->getQueueDepth(Scheduler::PRIORITY_LOW);
+            normal_depth = Scheduler::GetThis()->getQueueDepth(Scheduler::PRIORITY_NORMAL);
+        }, -1, Scheduler::PRIORITY_HIGH);
+        zjl::Fiber::YieldToReady();
+    }, -1, Scheduler::PRIORITY_LOW);
+    sc.stop();
+    std::cout << "低优先级任务让出后，低优先级队列深度 " << low_depth
+              << "，普通优先级队列深度 " << normal_depth << std::endl;
+    assert(low_depth == 1);
+    assert(normal_depth == 0);
+}
+
+// 绑定在空闲线程上的任务立即被执行：另一条线程正在忙、队列中还有其他任务时，也不能等到 epoll_wait 超时
+void TEST_pinnedWakeup()
+{
+    zjl::IOManager iom(2, false, "pinned");
+    std::vector<long> thread_ids;
+    while (thread_ids.size() < 2)
+    {
+        thread_ids.clear();
+        for (auto& worker : iom.getStats().workers)
+        {
+            if (worker.thread_id != -1)
+            {
+                thread_ids.push_back(worker.thread_id);
+            }
+        }
+    }
+    std::atomic_bool release{false};
+    std::atomic_uint64_t ran_ns{0};
+    // 第一条线程一直忙，信箱里还有排队的任务
+    for (int i = 0; i < 3; i++)
+    {
+        iom.schedule([&release]() {
+            while (!release)
+            {
+                sched_yield();
+            }
+        }, thread_ids[0]);
+    }
+    // 等第二条线程进入 epoll_wait
+    usleep(100 * 1000);
+    uint64_t begin = zjl::GetCurrentNS();
+    iom.schedule([&ran_ns]() { ran_ns = zjl::GetCurrentNS(); }, thread_ids[1]);
+    while (ran_ns == 0 && zjl::GetCurrentNS() - begin < 2000000000ull)
+    {
+        usleep(1000);
+    }
+    release = true;
+    uint64_t delay_ms = ran_ns ? (ran_ns - begin) / 1000000 : ~0ull;
+    std::cout << "绑定在空闲线程上的任务等待了 " << delay_ms << " ms" << std::endl;
+    assert(delay_ms < 100);
+}
+
+// 测试统计信息，任务执行结束后各项计数应与调度的任务数一致
+void TEST_stats()
+{
+    zjl::Scheduler sc(2, false, "stats");
+    sc.start();
+    for (int i = 0; i < 1000; i++)
+    {
+        sc.schedule([]() {});
+    }
+    sc.stop();
+    auto stats = sc.getStats();
+    uint64_t tasks = 0;
+    for (auto& worker : stats.workers)
+    {
+        tasks += worker.tasks;
+    }
+    sc.dumpStats();
+    assert(stats.queue_length == 0);
+    assert(stats.queue_delay.count == 1000);
+    assert(stats.run_time.count == 1000);
+    assert(tasks == 1000);
+    assert(stats.queue_delay.percentile(0.5) <= stats.queue_delay.percentile(0.99));
+}
+
+// 统计正在工作的调度线程数量
+static size_t LiveWorkerCount(const zjl::Scheduler& sc)
+{
+    size_t count = 0;
+    for (auto& worker : sc.getStats().workers)
+    {
+        count += worker.thread_id != -1;
+    }
+    return count;
+}
+
+// 测试运行时调整线程数量，缩容时退出线程的任务转交给其他线程，以及通过配置项调整
+void TEST_resize()
+{
+    std::atomic_uint64_t done{0};
+    zjl::Scheduler sc(2, false, "resize");
+    sc.start();
+    sc.setThreadCount(6);
+    assert(sc.getThreadCount() == 6);
+    assert(LiveWorkerCount(sc) == 6);
+    for (int i = 0; i < 1000; i++)
+    {
+        sc.schedule([&done]() { ++done; });
+    }
+    sc.setThreadCount(1);
+    assert(sc.getThreadCount() == 1);
+    // 退出的线程执行完当前任务后才会注销
+    while (LiveWorkerCount(sc) != 1)
+    {
+        sched_yield();
+    }
+    for (int i = 0; i < 1000; i++)
+    {
+        sc.schedule([&done]() { ++done; });
+    }
+    // 修改配置项后线程数量随之调整
+    zjl::Config::Lookup<std::map<std::string, int>>("scheduler.threads")
+        ->setValue({{"resize", 3}});
+    assert(sc.getThreadCount() == 3);
+    sc.stop();
+    std::cout << "调整线程数量后执行了 " << done << " 个任务" << std::endl;
+    assert(done == 2000);
+}
+
+// IOManager 反复缩容又扩容后，每条登记的线程都还在执行任务；缩容不需要等到 epoll_wait 超时
+void TEST_resizeIOManager()
+{
+    zjl::IOManager iom(4, false, "io_resize");
+    for (int i = 0; i < 50; i++)
+    {
+        iom.setThreadCount(1);
+        // 让退出的线程有机会在扩容撤销缩容之前或之后回到 run()
+        usleep(i * 100);
+        iom.setThreadCount(4);
+    }
+    usleep(100 * 1000);
+    assert(iom.getThreadCount() == 4);
+    std::vector<long> thread_ids;
+    for (auto& worker : iom.getStats().workers)
+    {
+        if (worker.thread_id != -1)
+        {
+            thread_ids.push_back(worker.thread_id);
+        }
+    }
+    assert(thread_ids.size() == 4);
+    // 绑定在每条登记的线程上的任务都能执行
+    std::atomic_size_t done{0};
+    for (long thread_id : thread_ids)
+    {
+        iom.schedule([&done]() { ++done; }, thread_id);
+    }
+    uint64_t begin = zjl::GetCurrentMS();
+    while (done != thread_ids.size() && zjl::GetCurrentMS() - begin < 2000)
+    {
+        usleep(1000);
+    }
+    assert(done == thread_ids.size());
+    begin = zjl::GetCurrentMS();
+    iom.setThreadCount(2);
+    while (LiveWorkerCount(iom) != 2 && zjl::GetCurrentMS() - begin < 2000)
+    {
+        usleep(1000);
+    }
+    uint64_t shrink_ms = zjl::GetCurrentMS() - begin;
+    std::cout << "IOManager 缩容等待了 " << shrink_ms << " ms" << std::endl;
+    assert(LiveWorkerCount(iom) == 2);
+    assert(shrink_ms < 200);
+}
+
+// 测试协程在两个调度器之间来回迁移
+void TEST_switchTo()
+{
+    zjl::Scheduler cpu(2, false, "cpu");
+    zjl::Scheduler io(1, false, "io");
+    cpu.start();
+    io.start();
+    long cpu_thread = cpu.getStats().workers[1].thread_id;
+    auto done = io.scheduleWithResult([&]() {
+        long io_thread = zjl::GetThreadID();
+        bool ok = zjl::Scheduler::GetThis() == &io;
+        // 迁移到计算调度器的指定线程上执行
+        zjl::Scheduler::SwitchTo(&cpu, cpu_thread);
+        ok = ok && zjl::Scheduler::GetThis() == &cpu && zjl::GetThreadID() == cpu_thread;
+        uint64_t sum = 0;
+        for (uint64_t i = 1; i <= 1000000; i++)
+        {
+            sum += i;
+        }
+        // 回到原来的调度器
+        zjl::Scheduler::SwitchTo(&io);
+        ok = ok && zjl::Scheduler::GetThis() == &io && zjl::GetThreadID() == io_thread;
+        return ok && sum == 500000500000ull;
+    });
+    bool ok = done.get();
+    io.stop();
+    cpu.stop();
+    std::cout << "协程在调度器之间迁移 " << (ok ? "成功" : "失败") << std::endl;
+    assert(ok);
+}
+
+// 回调任务复用执行结束的协程，复用的协程不会带着上一个任务设置的截止时间
+void TEST_fiberCache()
+{
+    std::set<uint64_t> fiber_ids;
+    int leaked = 0;
+    zjl::Scheduler sc(1, false, "cache");
+    sc.start();
+    for (int i = 0; i < 1000; i++)
+    {
+        sc.schedule([&fiber_ids, &leaked]() {
+            auto fiber = zjl::Fiber::GetThis();
+            fiber_ids.insert(fiber->getID());
+            leaked += fiber->getDeadline() != 0;
+            fiber->setDeadline(zjl::GetCurrentMS() + 1000);
+        });
+    }
+    sc.stop();
+    uint64_t reuses = sc.getStats().workers[0].fiber_reuses;
+    std::cout << "1000 个回调任务使用了 " << fiber_ids.size() << " 个协程，复用 " << reuses << " 次" << std::endl;
+    assert(leaked == 0);
+    assert(fiber_ids.size() + reuses == 1000);
+    assert(fiber_ids.size() < 100);
+}
+
+// 内联回调在调度协程上执行，不创建也不复用协程，执行期间关闭 hook
+void TEST_scheduleInline()
+{
+    int count = 0;
+    int on_main_fiber = 0;
+    int hooked = 0;
+    zjl::Scheduler sc(1, false, "inline");
+    sc.start();
+    for (int i = 0; i < 1000; i++)
+    {
+        sc.scheduleInline([&]() {
+            ++count;
+            on_main_fiber += zjl::Fiber::GetThis().get() == zjl::Scheduler::GetMainFiber();
+            hooked += zjl::isHookEnabled();
+        });
+    }
+    sc.stop();
+    auto stats = sc.getStats();
+    std::cout << "内联执行 " << count << " 个回调，其中 " << on_main_fiber << " 个在调度协程上执行" << std::endl;
+    assert(count == 1000);
+    assert(on_main_fiber == 1000);
+    assert(hooked == 0);
+    assert(stats.workers[0].tasks == 1000);
+    assert(stats.workers[0].fiber_reuses == 0);
+}
+
 int main(int, char**)
 {
+    // 主线程同一时刻只能有一个 use_caller 的调度器，先于下面的调度器执行
+    TEST_priority();
+
     zjl::Scheduler sc(2, true);
     sc.start();
 
@@ -34,5 +392,15 @@ int main(int, char**)
     }
 
     sc.stop();
+
+    TEST_taskAllocation();
+    TEST_yieldKeepsPriority();
+    TEST_pinnedWakeup();
+    TEST_stats();
+    TEST_resize();
+    TEST_resizeIOManager();
+    TEST_switchTo();
+    TEST_fiberCache();
+    TEST_scheduleInline();
     return 0;
 }
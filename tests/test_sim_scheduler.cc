@@ -0,0 +1,105 @@
+#include "log.h"
+#include "sim_scheduler.h"
+#include "util.h"
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// 用给定种子运行一组互相交错的任务，返回执行顺序
+static std::vector<int> runTrace(uint64_t seed, uint64_t& virtual_ms)
+{
+    std::vector<int> trace;
+    zjl::SimScheduler sim(seed);
+    for (int i = 0; i < 5; i++)
+    {
+        sim.schedule([&trace, i]() {
+            for (int round = 0; round < 3; round++)
+            {
+                trace.push_back(i);
+                zjl::Fiber::YieldToReady();
+            }
+            // 虚拟时钟，不会真正等待
+            usleep((i + 1) * 100 * 1000);
+            trace.push_back(i + 10);
+        });
+    }
+    sim.stop();
+    virtual_ms = sim.nowMS();
+    return trace;
+}
+
+// 相同的种子得到相同的执行顺序，不同的种子探索不同的执行顺序
+void TEST_determinism()
+{
+    uint64_t begin = zjl::GetCurrentMS();
+    uint64_t virtual_ms = 0;
+    std::vector<int> first = runTrace(42, virtual_ms);
+    std::vector<int> second = runTrace(42, virtual_ms);
+    std::set<std::vector<int>> distinct;
+    for (uint64_t seed = 0; seed < 10; seed++)
+    {
+        distinct.insert(runTrace(seed, virtual_ms));
+    }
+    uint64_t elapsed = zjl::GetCurrentMS() - begin;
+    std::cout << "determinism: same seed equal = " << (first == second)
+              << ", distinct traces = " << distinct.size()
+              << ", virtual time = " << virtual_ms << " ms, real time = " << elapsed << " ms" << std::endl;
+    assert(first == second);
+    assert(first.size() == 20);
+    assert(distinct.size() > 1);
+    // 睡眠最长的任务睡了 500 ms 虚拟时间
+    assert(virtual_ms == 500);
+    assert(elapsed < 1000);
+}
+
+// 回环 socket 在模拟调度器上的请求与响应
+void TEST_loopback()
+{
+    std::string request;
+    std::string response;
+    ssize_t eof = -1;
+    uint64_t virtual_ms = 0;
+    {
+        zjl::SimScheduler sim(7);
+        auto sockets = zjl::LoopbackSocket::CreatePair();
+        auto client = sockets.first;
+        auto server = sockets.second;
+        sim.schedule([&]() {
+            char buffer[64];
+            ssize_t n = server->read(buffer, sizeof(buffer));
+            request.assign(buffer, n);
+            // 模拟处理耗时
+            usleep(30 * 1000);
+            server->write("pong", 4);
+            server->close();
+        });
+        sim.schedule([&]() {
+            usleep(10 * 1000);
+            client->write("ping", 4);
+            char buffer[64];
+            ssize_t n = client->read(buffer, sizeof(buffer));
+            response.assign(buffer, n);
+            eof = client->read(buffer, sizeof(buffer));
+            virtual_ms = zjl::SimScheduler::GetThis()->nowMS();
+        });
+        sim.stop();
+    }
+    std::cout << "loopback: request = " << request << ", response = " << response
+              << ", eof = " << eof << ", virtual time = " << virtual_ms << " ms" << std::endl;
+    assert(request == "ping");
+    assert(response == "pong");
+    assert(eof == 0);
+    assert(virtual_ms == 40);
+}
+
+int main(int, char**)
+{
+    GET_ROOT_LOGGER()->setLevel(zjl::LogLevel::WARN);
+    TEST_determinism();
+    TEST_loopback();
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include "fd_manager.h"
+#include "io_manager.h"
+#include "log.h"
+#include "task_group.h"
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// 所有子任务正常结束
+void TEST_allSucceed()
+{
+    std::atomic_int sum{0};
+    bool ok = false;
+    {
+        zjl::IOManager iom(4, false, "group_ok");
+        iom.schedule([&]() {
+            zjl::TaskGroup group;
+            for (int i = 1; i <= 100; i++)
+            {
+                group.spawn([&sum, i]() {
+                    usleep(1000);
+                    sum += i;
+                });
+            }
+            ok = group.wait();
+        });
+    }
+    std::cout << "all succeed sum = " << sum << std::endl;
+    assert(ok);
+    assert(sum == 5050);
+}
+
+// 一个子任务失败后，其他在 sleep 中的子任务立刻被唤醒
+void TEST_firstFailure()
+{
+    std::atomic_int cancelled{0};
+    bool caught = false;
+    uint64_t elapsed = 0;
+    {
+        zjl::IOManager iom(2, false, "group_fail");
+        iom.schedule([&]() {
+            uint64_t begin = zjl::GetCurrentMS();
+            zjl::TaskGroup group;
+            for (int i = 0; i < 10; i++)
+            {
+                group.spawn([&cancelled]() {
+                    if (sleep(10) != 0 && errno == ECANCELED)
+                    {
+                        ++cancelled;
+                    }
+                });
+            }
+            group.spawn([]() {
+                usleep(20 * 1000);
+                throw std::runtime_error("backend failed");
+            });
+            try
+            {
+                group.wait();
+            }
+            catch (const std::runtime_error&)
+            {
+                caught = true;
+            }
+            elapsed = zjl::GetCurrentMS() - begin;
+        });
+    }
+    std::cout << "first failure: caught = " << caught << ", cancelled = " << cancelled
+              << ", elapsed = " << elapsed << " ms" << std::endl;
+    assert(caught);
+    assert(cancelled == 10);
+    assert(elapsed < 1000);
+}
+
+// 到达截止时间后，阻塞在 socket 读上的子任务被中断，内层任务组一起取消
+void TEST_deadline()
+{
+    int fds[2];
+    int rt = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    assert(rt == 0);
+    std::atomic_int timed_out{0};
+    bool ok = true;
+    uint64_t elapsed = 0;
+    {
+        zjl::IOManager iom(2, false, "group_deadline");
+        iom.schedule([&]() {
+            zjl::FileDescriptorManager::GetInstance()->get(fds[0], true);
+            uint64_t begin = zjl::GetCurrentMS();
+            zjl::TaskGroup group(&iom, 100);
+            group.spawn([&]() {
+                char buf[16];
+                // 对端不会写入数据
+                if (read(fds[0], buf, sizeof(buf)) == -1 && errno == ETIMEDOUT)
+                {
+                    ++timed_out;
+                }
+            });
+            group.spawn([&]() {
+                zjl::TaskGroup inner;
+                inner.spawn([&timed_out]() {
+                    if (sleep(10) != 0 && errno == ETIMEDOUT)
+                    {
+                        ++timed_out;
+                    }
+                });
+                inner.wait();
+            });
+            ok = group.wait();
+            elapsed = zjl::GetCurrentMS() - begin;
+            // 在 hook 开启的线程中关闭，同时移除 fd 的上下文
+            close(fds[0]);
+        });
+    }
+    close(fds[1]);
+    std::cout << "deadline: ok = " << ok << ", timed out = " << timed_out
+              << ", elapsed = " << elapsed << " ms" << std::endl;
+    assert(!ok);
+    assert(timed_out == 2);
+    assert(elapsed < 1000);
+}
+
+// 协程的截止时间限制被 hook 的读与 sleep，并传递给任务组的子任务
+void TEST_deadlineScope()
+{
+    int fds[2];
+    int rt = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    assert(rt == 0);
+    bool read_timed_out = false;
+    bool sleep_truncated = false;
+    bool child_timed_out = false;
+    uint64_t elapsed = 0;
+    {
+        zjl::IOManager iom(2, false, "deadline_scope");
+        iom.schedule([&]() {
+            zjl::FileDescriptorManager::GetInstance()->get(fds[0], true);
+            uint64_t begin = zjl::GetCurrentMS();
+            {
+                zjl::DeadlineScope scope(50);
+                char buf[16];
+                read_timed_out = read(fds[0], buf, sizeof(buf)) == -1 && errno == ETIMEDOUT;
+            }
+            {
+                zjl::DeadlineScope scope(50);
+                sleep_truncated = sleep(10) != 0 && errno == ETIMEDOUT;
+                // 外层已经到期，内层不会放宽截止时间
+                zjl::DeadlineScope inner(10000);
+                zjl::TaskGroup group;
+                group.spawn([&child_timed_out]() {
+                    child_timed_out = usleep(1000 * 1000) == -1 && errno == ETIMEDOUT;
+                });
+                group.wait();
+            }
+            assert(zjl::Fiber::GetThis()->getDeadline() == 0);
+            elapsed = zjl::GetCurrentMS() - begin;
+            close(fds[0]);
+        });
+    }
+    close(fds[1]);
+    std::cout << "deadline scope: read timed out = " << read_timed_out << ", sleep truncated = " << sleep_truncated
+              << ", child timed out = " << child_timed_out << ", elapsed = " << elapsed << " ms" << std::endl;
+    assert(read_timed_out);
+    assert(sleep_truncated);
+    assert(child_timed_out);
+    assert(elapsed < 1000);
+}
+
+int main(int, char**)
+{
+    GET_ROOT_LOGGER()->setLevel(zjl::LogLevel::WARN);
+    TEST_allSucceed();
+    TEST_firstFailure();
+    TEST_deadline();
+    TEST_deadlineScope();
+    return 0;
+}
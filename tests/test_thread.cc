@@ -1,6 +1,8 @@
 #include "log.h"
 #include "thread.h"
+#include <cassert>
 #include <memory>
+#include <sched.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <vector>
@@ -70,10 +72,44 @@ void TEST_readWriteLock()
     LOG_FMT_DEBUG(g_logger, "count = %ld", count);
 }
 
+// 测试线程绑定 CPU
+void TEST_affinity()
+{
+    LOG_DEBUG(g_logger, "Call TEST_affinity() 测试线程绑定 CPU");
+    // 选择当前进程允许使用的最后一个 CPU
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    sched_getaffinity(0, sizeof(cpu_set), &cpu_set);
+    int target = -1;
+    for (int i = 0; i < CPU_SETSIZE; i++)
+    {
+        if (CPU_ISSET(i, &cpu_set))
+        {
+            target = i;
+        }
+    }
+    zjl::ThreadAffinity affinity;
+    affinity.cpus.push_back(target);
+    int running_cpu = -1;
+    int allowed_count = 0;
+    zjl::Thread thread([&running_cpu, &allowed_count]() {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        sched_getaffinity(0, sizeof(set), &set);
+        allowed_count = CPU_COUNT(&set);
+        running_cpu = sched_getcpu();
+    }, "affinity", affinity);
+    thread.join();
+    LOG_FMT_DEBUG(g_logger, "绑定 CPU %d，实际运行在 CPU %d", target, running_cpu);
+    assert(allowed_count == 1);
+    assert(running_cpu == target);
+}
+
 int main()
 {
     TEST_createThread();
     TEST_readWriteLock();
+    TEST_affinity();
 
     // sleep(3);
     return 0;
@@ -0,0 +1,130 @@
+#include "config.h"
+#include "io_manager.h"
+#include "log.h"
+#include "scheduler.h"
+#include "util.h"
+#include "watchdog.h"
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <string>
+
+// 占用 CPU ms 毫秒，yield 为 true 时在循环中调用抢占点
+static void busyLoop(uint64_t ms, bool yield)
+{
+    uint64_t end = zjl::GetCurrentMS() + ms;
+    while (zjl::GetCurrentMS() < end)
+    {
+        if (yield)
+        {
+            zjl::Fiber::maybeYield();
+        }
+    }
+}
+
+// 单条调度线程上，调用抢占点的 CPU 密集任务不会让后面的任务等到它结束
+void TEST_maybeYield()
+{
+    uint64_t begin = zjl::GetCurrentMS();
+    std::atomic_uint64_t short_task_delay{0};
+    {
+        zjl::Scheduler sc(1, false, "slice");
+        sc.start();
+        sc.schedule([]() { busyLoop(300, true); });
+        sc.schedule([&]() { short_task_delay = zjl::GetCurrentMS() - begin; });
+        sc.stop();
+    }
+    std::cout << "short task delay = " << short_task_delay << " ms" << std::endl;
+    assert(short_task_delay < 150);
+}
+
+// 记录看门狗输出的超时报告
+class OverrunAppender : public zjl::LogAppender
+{
+public:
+    void log(zjl::LogLevel::Level /*level*/, zjl::LogEvent::ptr ev) override
+    {
+        const std::string& content = ev->getContent();
+        if (content.find("没有让出") == std::string::npos)
+        {
+            return;
+        }
+        zjl::ScopedLock lock(&m_mutex);
+        ++reports;
+        // 没有获取到调用栈时输出 "(未获取)"
+        missing_stacks += content.find("(未获取)") != std::string::npos;
+    }
+
+    int reports = 0;
+    int missing_stacks = 0;
+};
+
+// 不让出的任务被看门狗发现，计入统计，并输出任务的调用栈
+void TEST_overrun(zjl::Scheduler& sc)
+{
+    zjl::Config::Lookup<int>("watchdog.threshold_ms")->setValue(50);
+    auto appender = std::make_shared<OverrunAppender>();
+    GET_LOGGER("system")->addAppender(appender);
+    uint64_t before = zjl::Watchdog::GetInstance()->getOverrunCount();
+    uint64_t overruns = 0;
+    // 等调度线程先进入一次 idle 协程，再执行任务
+    usleep(50 * 1000);
+    sc.schedule([]() { busyLoop(400, false); });
+    // 每次执行只报告一次
+    sc.schedule([]() { busyLoop(400, false); });
+    sc.stop();
+    for (auto& worker : sc.getStats().workers)
+    {
+        overruns += worker.overruns;
+    }
+    GET_LOGGER("system")->delAppender(appender);
+    uint64_t total = zjl::Watchdog::GetInstance()->getOverrunCount() - before;
+    std::cout << "overruns = " << overruns << ", watchdog total = " << total
+              << ", reports without stack = " << appender->missing_stacks << std::endl;
+    assert(overruns == 2);
+    assert(total == 2);
+    assert(appender->reports == 2);
+    assert(appender->missing_stacks == 0);
+}
+
+// IOManager 的调度线程执行任务时也能响应调用栈采样
+void TEST_captureOnIOManager()
+{
+    std::atomic_bool started{false};
+    std::string stack;
+    {
+        zjl::IOManager iom(1, false, "capture");
+        // 等调度线程先进入一次 idle 协程，再执行任务
+        usleep(50 * 1000);
+        iom.schedule([&started]() {
+            started = true;
+            busyLoop(300, false);
+        });
+        while (!started)
+        {
+            sched_yield();
+        }
+        long thread_id = iom.getStats().workers[0].thread_id;
+        stack = zjl::Watchdog::GetInstance()->captureBacktrace(thread_id);
+    }
+    std::cout << "IOManager worker stack:\n" << stack;
+    assert(!stack.empty());
+}
+
+int main(int, char**)
+{
+    GET_ROOT_LOGGER()->setLevel(zjl::LogLevel::WARN);
+    TEST_maybeYield();
+    {
+        zjl::Scheduler sc(2, false, "hog");
+        sc.start();
+        TEST_overrun(sc);
+    }
+    {
+        zjl::IOManager iom(2, false, "io_hog");
+        TEST_overrun(iom);
+    }
+    TEST_captureOnIOManager();
+    return 0;
+}